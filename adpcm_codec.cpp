@@ -2,8 +2,16 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <numeric>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "adpcm_codec.h"
 
 // Taken from ADPCM reference
@@ -27,22 +35,31 @@ std::vector<int8_t> adpcm_index_table = {
 
 // Utility helpers
 
-static int16_t adpcm_clip_int16(int a) {
-  if ((a + 0x8000U) & ~0xFFFF)
+template <typename Counters> static int16_t adpcm_clip_int16(int a, Counters &counters) {
+  if ((a + 0x8000U) & ~0xFFFF) {
+    counters.clip();
     return (a >> 31) ^ 0x7FFF;
-  else
+  } else
     return a;
 }
 
+template <typename Counters> static int adpcm_clamp_step_index(int step_index, Counters &counters) {
+  if (step_index < 0 || step_index > 88) {
+    counters.step_index_clamp();
+  }
+  return std::clamp(step_index, 0, 88);
+}
+
 // Code borrowed from FFMPEG
-static inline int adpcm_ima_qt_expand_nibble(const std::shared_ptr<ADPCMChannelStatus> &c, int nibble) {
+template <typename Counters>
+static inline int adpcm_ima_qt_expand_nibble(ADPCMChannelStatus &c, int nibble, Counters &counters) {
   int step_index;
   int predictor;
   int diff, step;
 
-  step = adpcm_step_table[c->step_index];
-  step_index = c->step_index + adpcm_index_table[nibble];
-  step_index = std::clamp(step_index, 0, 88);
+  step = adpcm_step_table[c.step_index];
+  step_index = c.step_index + adpcm_index_table[nibble];
+  step_index = adpcm_clamp_step_index(step_index, counters);
 
   diff = step >> 3;
   if (nibble & 4)
@@ -53,20 +70,22 @@ static inline int adpcm_ima_qt_expand_nibble(const std::shared_ptr<ADPCMChannelS
     diff += step >> 2;
 
   if (nibble & 8)
-    predictor = c->predictor - diff;
+    predictor = c.predictor - diff;
   else
-    predictor = c->predictor + diff;
+    predictor = c.predictor + diff;
 
-  c->predictor = adpcm_clip_int16(predictor);
-  c->step_index = step_index;
+  c.predictor = adpcm_clip_int16(predictor, counters);
+  c.step_index = step_index;
+  counters.sample(nibble, step_index);
 
-  return c->predictor;
+  return c.predictor;
 }
 
 // Code borrowed from FFMPEG
-static inline uint8_t adpcm_ima_qt_compress_sample(const std::shared_ptr<ADPCMChannelStatus> &c, int16_t sample) {
-  int delta = sample - c->prev_sample;
-  int diff, step = adpcm_step_table[c->step_index];
+template <typename Counters>
+static inline uint8_t adpcm_ima_qt_compress_sample(ADPCMChannelStatus &c, int16_t sample, Counters &counters) {
+  int delta = sample - c.prev_sample;
+  int diff, step = adpcm_step_table[c.step_index];
   int nibble = 8 * (delta < 0);
 
   delta = abs(delta);
@@ -89,48 +108,220 @@ static inline uint8_t adpcm_ima_qt_compress_sample(const std::shared_ptr<ADPCMCh
   diff -= delta;
 
   if (nibble & 8)
-    c->prev_sample -= diff;
+    c.prev_sample -= diff;
   else
-    c->prev_sample += diff;
+    c.prev_sample += diff;
 
-  c->prev_sample = adpcm_clip_int16(c->prev_sample);
-  c->step_index = std::clamp(c->step_index + adpcm_index_table[nibble], 0, 88);
+  c.prev_sample = adpcm_clip_int16(c.prev_sample, counters);
+  c.step_index = adpcm_clamp_step_index(c.step_index + adpcm_index_table[nibble], counters);
+  counters.sample(nibble, c.step_index);
 
   return nibble;
 }
 
-int adpcm_rib_decode_frame(const std::shared_ptr<std::vector<int8_t>> &in_stream,
-                           const std::shared_ptr<std::vector<int16_t>> &out_stream) {
-  auto channel_status = std::make_shared<ADPCMChannelStatus>();
+// Encoded silence for each step_index, stored until encoder comes to rest (zero sample with zero step_index).
+// After that point encoder produces only zero nibbles.
+struct ADPCMSilentFrame {
+  std::array<int8_t, 64> data;
+  size_t size;
+};
 
-  channel_status->predictor = (((uint32_t)in_stream->at(1)) << 8) | (uint8_t)in_stream->at(0);
-  channel_status->step_index = in_stream->at(2);
+static const std::array<ADPCMSilentFrame, 89> &adpcm_silent_frames() {
+  static const std::array<ADPCMSilentFrame, 89> silent_frames = [] {
+    std::array<ADPCMSilentFrame, 89> frames{};
+    ADPCMNoCounters counters;
+    for (int16_t step_index = 0; step_index < 89; step_index++) {
+      ADPCMChannelStatus c{0, step_index, 0};
+      auto &frame = frames[step_index];
+      while (c.prev_sample != 0 || c.step_index != 0) {
+        if (frame.size == frame.data.size()) {
+          // Never happens with reference tables, but slow path is always correct
+          frame.size = SIZE_MAX;
+          break;
+        }
+        uint8_t nibble1 = adpcm_ima_qt_compress_sample(c, 0, counters);
+        uint8_t nibble2 = adpcm_ima_qt_compress_sample(c, 0, counters);
+        frame.data[frame.size++] = (int8_t)(nibble2 << 4 | nibble1);
+      }
+    }
+    return frames;
+  }();
+  return silent_frames;
+}
+
+// OR-reduction of buffer
+static bool adpcm_is_zero(const void *data, size_t size) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  size_t pos = 0;
+#ifdef __SSE2__
+  __m128i acc = _mm_setzero_si128();
+  for (; pos + 16 <= size; pos += 16) {
+    acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + pos)));
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+#endif
+  uint64_t acc64 = 0;
+  for (; pos + sizeof(acc64) <= size; pos += sizeof(acc64)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + pos, sizeof(word));
+    acc64 |= word;
+  }
+  for (; pos < size; pos++) {
+    acc64 |= bytes[pos];
+  }
+  return acc64 == 0;
+}
+
+bool adpcm_rib_is_silent_frame(std::span<const int8_t> in_stream) {
+  return adpcm_is_zero(in_stream.data(), in_stream.size_bytes());
+}
+
+template <typename Counters>
+int adpcm_rib_decode_frame(std::span<const int8_t> in_stream, std::span<int16_t> out_stream,
+                           ADPCMChannelStatus &channel_status, Counters &counters) {
+  // Zero frame (predictor 0, step_index 0, zero nibbles) always decodes to silence
+  if (!Counters::is_enabled && adpcm_rib_is_silent_frame(in_stream)) {
+    std::fill_n(out_stream.begin(), 2 * (in_stream.size() - 4) + 1, 0);
+    channel_status.predictor = 0;
+    channel_status.step_index = 0;
+    return 0;
+  }
+
+  channel_status.predictor = (((uint32_t)in_stream[1]) << 8) | (uint8_t)in_stream[0];
+  // Frame header comes from file, so step index is kept within step table
+  channel_status.step_index = adpcm_clamp_step_index(in_stream[2], counters);
 
   // Save first sample as is
-  out_stream->push_back((int16_t)channel_status->predictor);
+  auto out = out_stream.begin();
+  *out++ = (int16_t)channel_status.predictor;
+
+  for (auto pos = in_stream.begin() + 4; pos != in_stream.end(); ++pos) {
+    *out++ = (int16_t)adpcm_ima_qt_expand_nibble(channel_status, ((uint8_t)*pos) & 0x0f, counters);
+    *out++ = (int16_t)adpcm_ima_qt_expand_nibble(channel_status, ((uint8_t)*pos) >> 4, counters);
+  }
+
+  return 0;
+}
 
-  for (auto pos = in_stream->cbegin() + 4; pos != in_stream->cend(); ++pos) {
-    out_stream->push_back((int16_t)adpcm_ima_qt_expand_nibble(channel_status, ((uint8_t)*pos) & 0x0f));
-    out_stream->push_back((int16_t)adpcm_ima_qt_expand_nibble(channel_status, ((uint8_t)*pos) >> 4));
+template <typename Counters>
+int adpcm_rib_encode_frame(ADPCMChannelStatus &channel_status, std::span<const int16_t> in_stream,
+                           std::span<int8_t> out_stream, Counters &counters) {
+  if (!Counters::is_enabled && adpcm_is_zero(in_stream.data(), in_stream.size_bytes())) {
+    const auto &frame = adpcm_silent_frames()[channel_status.step_index];
+    size_t size = (in_stream.size() - 1) / 2;
+    if (frame.size <= size) {
+      out_stream[0] = 0;
+      out_stream[1] = 0;
+      out_stream[2] = (int8_t)channel_status.step_index;
+      out_stream[3] = 0;
+      std::copy_n(frame.data.begin(), frame.size, out_stream.begin() + 4);
+      std::fill_n(out_stream.begin() + 4 + frame.size, size - frame.size, 0);
+      channel_status.prev_sample = 0;
+      channel_status.step_index = 0;
+      return 0;
+    }
   }
 
+  channel_status.prev_sample = in_stream[0];
+  auto out = out_stream.begin();
+  *out++ = (int8_t)((uint8_t)(channel_status.prev_sample & 0xFF));
+  *out++ = (int8_t)(channel_status.prev_sample >> 8);
+  *out++ = (int8_t)channel_status.step_index;
+  *out++ = 0;
+
+  auto pos = in_stream.begin() + 1;
+  while (pos != in_stream.end()) {
+    uint8_t nibble1 = adpcm_ima_qt_compress_sample(channel_status, *pos++, counters);
+    uint8_t nibble2 = adpcm_ima_qt_compress_sample(channel_status, *pos++, counters);
+    *out++ = (int8_t)(nibble2 << 4 | nibble1);
+  }
   return 0;
 }
 
+template int adpcm_rib_decode_frame(std::span<const int8_t>, std::span<int16_t>, ADPCMChannelStatus &,
+                                    ADPCMNoCounters &);
+template int adpcm_rib_decode_frame(std::span<const int8_t>, std::span<int16_t>, ADPCMChannelStatus &,
+                                    ADPCMCounters &);
+template int adpcm_rib_encode_frame(ADPCMChannelStatus &, std::span<const int16_t>, std::span<int8_t>,
+                                    ADPCMNoCounters &);
+template int adpcm_rib_encode_frame(ADPCMChannelStatus &, std::span<const int16_t>, std::span<int8_t>,
+                                    ADPCMCounters &);
+
+int adpcm_rib_decode_frame(std::span<const int8_t> in_stream, std::span<int16_t> out_stream,
+                           ADPCMChannelStatus &channel_status) {
+  ADPCMNoCounters counters;
+  return adpcm_rib_decode_frame(in_stream, out_stream, channel_status, counters);
+}
+
+int adpcm_rib_encode_frame(ADPCMChannelStatus &channel_status, std::span<const int16_t> in_stream,
+                           std::span<int8_t> out_stream) {
+  ADPCMNoCounters counters;
+  return adpcm_rib_encode_frame(channel_status, in_stream, out_stream, counters);
+}
+
+uint64_t ADPCMCounters::samples() const { return std::accumulate(nibbles.begin(), nibbles.end(), uint64_t{0}); }
+
+ADPCMCounters &ADPCMCounters::operator+=(const ADPCMCounters &other) {
+  clips += other.clips;
+  step_index_clamps += other.step_index_clamps;
+  for (size_t i = 0; i < step_indexes.size(); i++) {
+    step_indexes[i] += other.step_indexes[i];
+  }
+  for (size_t i = 0; i < nibbles.size(); i++) {
+    nibbles[i] += other.nibbles[i];
+  }
+  return *this;
+}
+
+void ADPCMCounters::print(std::ostream &output) const {
+  uint64_t total = samples();
+  auto percent = [total](uint64_t count) { return total == 0 ? 0.0 : 100.0 * (double)count / (double)total; };
+  output << std::format("{} samples, {} clipped ({:.4f}%), {} step index saturations ({:.2f}%)\n", total, clips,
+                        percent(clips), step_index_clamps, percent(step_index_clamps));
+
+  // Smallest step index covering share of samples
+  auto step_index_percentile = [&](double p) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < step_indexes.size(); i++) {
+      count += step_indexes[i];
+      if ((double)count >= p * (double)total) {
+        return i;
+      }
+    }
+    return step_indexes.size() - 1;
+  };
+  uint64_t high = std::accumulate(step_indexes.begin() + 80, step_indexes.end(), uint64_t{0});
+  output << std::format("  step index p50 {}, p99 {}, max {}, >= 80 {:.3f}%\n", step_index_percentile(0.5),
+                        step_index_percentile(0.99), total == 0 ? 0 : step_index_percentile(1.0), percent(high));
+  output << "  step index histogram:";
+  for (size_t i = 0; i < step_indexes.size(); i += 10) {
+    uint64_t count = std::accumulate(step_indexes.begin() + i,
+                                     step_indexes.begin() + std::min<size_t>(i + 10, step_indexes.size()), uint64_t{0});
+    output << std::format(" {}-{}: {:.1f}%", i, std::min<size_t>(i + 9, 88), percent(count));
+  }
+  output << "\n  nibbles:";
+  for (size_t i = 0; i < nibbles.size(); i++) {
+    output << std::format(" {:x}: {:.1f}%", i, percent(nibbles[i]));
+  }
+  output << "\n";
+}
+
+int adpcm_rib_decode_frame(const std::shared_ptr<std::vector<int8_t>> &in_stream,
+                           const std::shared_ptr<std::vector<int16_t>> &out_stream) {
+  ADPCMChannelStatus channel_status{};
+  size_t offset = out_stream->size();
+
+  out_stream->resize(offset + 2 * (in_stream->size() - 4) + 1);
+  return adpcm_rib_decode_frame(*in_stream, std::span(*out_stream).subspan(offset), channel_status);
+}
+
 int adpcm_rib_encode_frame(const std::shared_ptr<ADPCMChannelStatus> &channel_status,
                            const std::shared_ptr<std::vector<int16_t>> &in_stream,
                            const std::shared_ptr<std::vector<int8_t>> &out_stream) {
-  channel_status->prev_sample = in_stream->at(0);
-  out_stream->push_back((int8_t)((uint8_t)(channel_status->prev_sample & 0xFF)));
-  out_stream->push_back((int8_t)(channel_status->prev_sample >> 8));
-  out_stream->push_back((int8_t)channel_status->step_index);
-  out_stream->push_back(0);
-
-  auto pos = in_stream->cbegin() + 1;
-  while (pos != in_stream->cend()) {
-    uint8_t nibble1 = adpcm_ima_qt_compress_sample(channel_status, *pos++);
-    uint8_t nibble2 = adpcm_ima_qt_compress_sample(channel_status, *pos++);
-    out_stream->push_back((int8_t)(nibble2 << 4 | nibble1));
-  }
-  return 0;
+  size_t offset = out_stream->size();
+
+  out_stream->resize(offset + (in_stream->size() - 1) / 2 + 4);
+  return adpcm_rib_encode_frame(*channel_status, *in_stream, std::span(*out_stream).subspan(offset));
 }
@@ -2,8 +2,11 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <ostream>
+#include <span>
 #include <vector>
 
 typedef struct ADPCMChannelStatus {
@@ -18,3 +21,83 @@ int adpcm_rib_decode_frame(const std::shared_ptr<std::vector<int8_t>> &in_stream
 int adpcm_rib_encode_frame(const std::shared_ptr<ADPCMChannelStatus> &channel_status,
                            const std::shared_ptr<std::vector<int16_t>> &in_stream,
                            const std::shared_ptr<std::vector<int8_t>> &out_stream);
+
+/**
+ * Kernel instrumentation policy that counts nothing. Its empty hooks are inlined away, so kernels instantiated with it
+ * are as fast as uninstrumented ones.
+ */
+struct ADPCMNoCounters {
+  static constexpr bool is_enabled = false;
+  void clip() {}
+  void step_index_clamp() {}
+  void sample(int, int) {}
+};
+
+/**
+ * Kernel instrumentation policy that counts events of encoded/decoded samples
+ */
+struct ADPCMCounters {
+  static constexpr bool is_enabled = true;
+  /// Samples clipped to int16 range (predictor of decoder, reconstructed sample of encoder)
+  uint64_t clips = 0;
+  /// Step index updates saturated at 0 or 88
+  uint64_t step_index_clamps = 0;
+  /// Histogram of step index after each sample
+  std::array<uint64_t, 89> step_indexes{};
+  /// Distribution of nibble values
+  std::array<uint64_t, 16> nibbles{};
+
+  void clip() { clips++; }
+  void step_index_clamp() { step_index_clamps++; }
+  void sample(int nibble, int step_index) {
+    nibbles[nibble]++;
+    step_indexes[step_index]++;
+  }
+  /// Number of counted samples (frame headers excluded)
+  [[nodiscard]] uint64_t samples() const;
+  ADPCMCounters &operator+=(const ADPCMCounters &other);
+  /// Clip and saturation rates, step index percentiles and nibble distribution
+  void print(std::ostream &output) const;
+};
+
+/**
+ * Check if RIB frame is filled with zeros (decodes to silence).
+ */
+bool adpcm_rib_is_silent_frame(std::span<const int8_t> in_stream);
+
+/**
+ * Decode single RIB frame into preallocated buffer. out_stream should hold 2 * (in_stream.size() - 4) + 1 samples.
+ * channel_status is left in the state after last decoded sample.
+ */
+int adpcm_rib_decode_frame(std::span<const int8_t> in_stream, std::span<int16_t> out_stream,
+                           ADPCMChannelStatus &channel_status);
+
+/**
+ * Encode single RIB frame into preallocated buffer. out_stream should hold (in_stream.size() - 1) / 2 + 4 bytes.
+ */
+int adpcm_rib_encode_frame(ADPCMChannelStatus &channel_status, std::span<const int16_t> in_stream,
+                           std::span<int8_t> out_stream);
+
+/**
+ * Decode single RIB frame, kernel events are passed to counters policy (ADPCMNoCounters or ADPCMCounters). Silent
+ * frame fast path is skipped by counting policies, so that every sample is counted.
+ */
+template <typename Counters>
+int adpcm_rib_decode_frame(std::span<const int8_t> in_stream, std::span<int16_t> out_stream,
+                           ADPCMChannelStatus &channel_status, Counters &counters);
+
+/**
+ * Encode single RIB frame, kernel events are passed to counters policy (ADPCMNoCounters or ADPCMCounters)
+ */
+template <typename Counters>
+int adpcm_rib_encode_frame(ADPCMChannelStatus &channel_status, std::span<const int16_t> in_stream,
+                           std::span<int8_t> out_stream, Counters &counters);
+
+extern template int adpcm_rib_decode_frame(std::span<const int8_t>, std::span<int16_t>, ADPCMChannelStatus &,
+                                           ADPCMNoCounters &);
+extern template int adpcm_rib_decode_frame(std::span<const int8_t>, std::span<int16_t>, ADPCMChannelStatus &,
+                                           ADPCMCounters &);
+extern template int adpcm_rib_encode_frame(ADPCMChannelStatus &, std::span<const int16_t>, std::span<int8_t>,
+                                           ADPCMNoCounters &);
+extern template int adpcm_rib_encode_frame(ADPCMChannelStatus &, std::span<const int16_t>, std::span<int8_t>,
+                                           ADPCMCounters &);
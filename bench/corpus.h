@@ -0,0 +1,64 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Layout of synthetic corpus files. File i of layout is <name>_<i>.rib, its source is <name>_<i>.wav or
+ * <name>_<i>_0.wav .. <name>_<i>_5.wav for complex layout.
+ */
+struct CorpusLayout {
+  const char *name;
+  bool is_mono;
+  uint32_t frequency;
+  uint32_t count_files;
+};
+
+inline constexpr std::array<CorpusLayout, 4> corpus_layouts = {{
+    {"mono44100", true, 44100, 1},
+    {"stereo22050", false, 22050, 1},
+    {"stereo44100", false, 44100, 1},
+    {"complex", false, 22050, 6},
+}};
+
+inline std::optional<CorpusLayout> find_corpus_layout(const std::string &name) {
+  for (const auto &layout : corpus_layouts) {
+    if (name == layout.name) {
+      return layout;
+    }
+  }
+  return std::nullopt;
+}
+
+inline std::vector<std::string> corpus_layout_names() {
+  std::vector<std::string> names;
+  for (const auto &layout : corpus_layouts) {
+    names.emplace_back(layout.name);
+  }
+  return names;
+}
+
+inline std::filesystem::path corpus_rib_path(const std::filesystem::path &dir, const CorpusLayout &layout,
+                                             uint32_t index) {
+  return dir / std::format("{}_{:04}.rib", layout.name, index);
+}
+
+inline std::vector<std::filesystem::path> corpus_wav_paths(const std::filesystem::path &dir,
+                                                           const CorpusLayout &layout, uint32_t index) {
+  if (layout.count_files == 1) {
+    return {dir / std::format("{}_{:04}.wav", layout.name, index)};
+  }
+  std::vector<std::filesystem::path> paths;
+  for (uint32_t i = 0; i < layout.count_files; i++) {
+    paths.push_back(dir / std::format("{}_{:04}_{}.wav", layout.name, index, i));
+  }
+  return paths;
+}
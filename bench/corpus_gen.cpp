@@ -0,0 +1,157 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * Generator of deterministic synthetic corpus: WAV files made of tones, noise and silence gaps and RIB files encoded
+ * from them. Same seed always gives same files.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "CLI11.hpp"
+#include "codec.h"
+#include "corpus.h"
+#include "wav.h"
+
+/**
+ * Endless signal of random segments: sine tones, white noise and silence
+ */
+class SignalGenerator {
+public:
+  SignalGenerator(uint64_t seed, uint32_t nb_channels, uint32_t frequency)
+      : m_random(seed), m_nb_channels(nb_channels), m_frequency(frequency) {}
+
+  /// Fill interleaved samples, continuing from previous call
+  void fill(std::span<int16_t> samples) {
+    for (size_t pos = 0; pos < samples.size(); pos += m_nb_channels) {
+      if (m_remaining == 0) {
+        next_segment();
+      }
+      m_remaining--;
+      for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+        double value = 0;
+        if (m_segment == Segment::Tone) {
+          // Channels are slightly detuned, so stereo image isn't mono
+          value = std::sin(m_phase * (1 + 0.01 * ch));
+        } else if (m_segment == Segment::Noise) {
+          value = uniform(-1, 1);
+        }
+        samples[pos + ch] = (int16_t)std::lround(value * m_amplitude);
+      }
+      m_phase += 2 * std::numbers::pi * m_tone / m_frequency;
+    }
+  }
+
+private:
+  enum class Segment { Tone, Noise, Silence };
+
+  /// Uniform value in [low, high). Standard distributions differ between implementations, engine output doesn't.
+  double uniform(double low, double high) { return low + (high - low) * (double)(m_random() >> 11) * 0x1.0p-53; }
+
+  void next_segment() {
+    // Half of segments are tones, rest is split between noise and silence
+    double kind = uniform(0, 1);
+    m_segment = kind < 0.5 ? Segment::Tone : kind < 0.8 ? Segment::Noise : Segment::Silence;
+    m_remaining = (uint64_t)uniform(m_frequency / 2.0, m_frequency * 3.0);
+    m_tone = uniform(55, 4000);
+    m_amplitude = uniform(1000, 30000);
+    m_phase = 0;
+  }
+
+  std::mt19937_64 m_random;
+  uint32_t m_nb_channels;
+  uint32_t m_frequency;
+  Segment m_segment = Segment::Silence;
+  uint64_t m_remaining = 0;
+  double m_tone = 0;
+  double m_amplitude = 0;
+  double m_phase = 0;
+};
+
+/// Seed of file, std::hash isn't stable between implementations
+uint64_t fnv1a(const std::string &text) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (char c : text) {
+    hash = (hash ^ (uint8_t)c) * 0x100000001b3;
+  }
+  return hash;
+}
+
+void write_wav(const std::filesystem::path &path, uint64_t seed, const CorpusLayout &layout, double seconds) {
+  uint32_t nb_channels = layout.is_mono ? 1 : 2;
+  uint64_t nb_samples = (uint64_t)(seconds * layout.frequency);
+  uint64_t data_size = nb_samples * nb_channels * sizeof(int16_t);
+
+  std::ofstream output(path, std::ios::binary);
+  auto header = make_wav_header(nb_channels, layout.frequency, data_size);
+  output.write(header.data(), header.size());
+
+  // File is written by blocks of one second, so corpus files may be larger than memory
+  SignalGenerator generator(seed, nb_channels, layout.frequency);
+  std::vector<int16_t> block(layout.frequency * nb_channels);
+  for (uint64_t done = 0; done < nb_samples;) {
+    size_t count = std::min<uint64_t>(layout.frequency, nb_samples - done);
+    std::span<int16_t> samples(block.data(), count * nb_channels);
+    generator.fill(samples);
+    for (auto &itm : samples) {
+      itm = UTILS::convert_le(itm);
+    }
+    output.write(reinterpret_cast<char *>(samples.data()), samples.size_bytes());
+    done += count;
+  }
+  if (!output) {
+    throw std::runtime_error(std::format("Can't write to output file {}", path.string()));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path out_dir = ".";
+  std::vector<std::string> layout_names = {"stereo22050"};
+  uint32_t count = 4;
+  double seconds = 60;
+  uint64_t seed = 1;
+
+  CLI::App app{"Generate deterministic synthetic corpus of WAV and RIB files"};
+  app.add_option("-o,--output", out_dir, "Output directory")->default_val(out_dir);
+  app.add_option("-l,--layout", layout_names, "Layouts of files")
+      ->default_val(layout_names)
+      ->check(CLI::IsMember(corpus_layout_names()))
+      ->delimiter(',');
+  app.add_option("-n,--count", count, "Number of files per layout")->default_val(count);
+  app.add_option("-s,--seconds", seconds, "Length of each file (substream of complex file)")
+      ->default_val(seconds)
+      ->check(CLI::PositiveNumber);
+  app.add_option("--seed", seed, "Seed of generated signal")->default_val(seed);
+  CLI11_PARSE(app, argc, argv);
+
+  try {
+    std::filesystem::create_directories(out_dir);
+    for (const auto &name : layout_names) {
+      auto layout = *find_corpus_layout(name);
+      Codec codec(layout.is_mono, layout.frequency, layout.count_files);
+      for (uint32_t i = 0; i < count; i++) {
+        auto wav_paths = corpus_wav_paths(out_dir, layout, i);
+        for (size_t k = 0; k < wav_paths.size(); k++) {
+          // Every file of corpus has its own signal, independent of count of files
+          write_wav(wav_paths.at(k), fnv1a(std::format("{}:{}:{}:{}", seed, name, i, k)), layout, seconds);
+        }
+        codec.encode(wav_paths, corpus_rib_path(out_dir, layout, i));
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,236 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * End-to-end throughput of Codec::decode/encode over corpus made by rib_corpus_gen: MB/s, files/s, CPU utilization
+ * and peak RSS of process. Optionally phase timings and hardware counters are reported per file and for whole run.
+ */
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CLI11.hpp"
+#include "codec.h"
+#include "corpus.h"
+#include "perf_counters.h"
+#include "stats.h"
+#include "trace.h"
+
+struct ResourceUsage {
+  /// User and system CPU time of all threads, seconds
+  double cpu = 0;
+  /// Peak resident set size, bytes
+  uint64_t max_rss = 0;
+};
+
+ResourceUsage resource_usage() {
+  ResourceUsage usage;
+#ifndef _WIN32
+  rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+  usage.cpu = (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6 + (double)ru.ru_stime.tv_sec +
+              (double)ru.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+  usage.max_rss = ru.ru_maxrss;
+#else
+  usage.max_rss = (uint64_t)ru.ru_maxrss * 1024;
+#endif
+#endif
+  return usage;
+}
+
+/// Stream buffer discarding everything
+class NullBuffer : public std::streambuf {
+protected:
+  int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+  std::streamsize xsputn(const char *, std::streamsize size) override { return size; }
+};
+
+struct Job {
+  std::vector<std::filesystem::path> inputs;
+  std::filesystem::path output;
+};
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path corpus_dir;
+  std::filesystem::path out_dir = std::filesystem::temp_directory_path() / "rib_e2e_bench";
+  std::string layout_name = "stereo22050";
+  std::string mode = "decode";
+  uint32_t nb_threads = 1;
+  uint64_t max_memory = 0;
+  bool is_stats = false;
+  bool is_perf_counters = false;
+  std::filesystem::path trace_file;
+
+  CLI::App app{"End-to-end decode/encode throughput over synthetic corpus"};
+  app.add_option("corpus", corpus_dir, "Corpus directory made by rib_corpus_gen")
+      ->required()
+      ->check(CLI::ExistingDirectory);
+  app.add_option("-l,--layout", layout_name, "Layout of files")
+      ->default_val(layout_name)
+      ->check(CLI::IsMember(corpus_layout_names()));
+  app.add_option("--mode", mode, "Operation")->default_val(mode)->check(CLI::IsMember({"decode", "encode"}));
+  app.add_option("-j,--threads", nb_threads, "Number of files converted in parallel")
+      ->default_val(nb_threads)
+      ->check(CLI::PositiveNumber);
+  app.add_option("--max-memory", max_memory,
+                 "Memory budget of whole run (e.g. 256MB), it's split between threads and limits their number")
+      ->transform(CLI::AsSizeValue(false));
+  app.add_option("-o,--output", out_dir, "Directory of converted files, removed afterwards")->default_val(out_dir);
+  app.add_flag("--stats", is_stats, "Report time of conversion phases for whole run");
+  app.add_flag("--perf-counters", is_perf_counters,
+               "Report hardware counters per file and for whole run (implies --stats)");
+  app.add_option("--trace", trace_file, "Record spans of workers into JSON file in Chrome trace event format");
+  CLI11_PARSE(app, argc, argv);
+
+  if (!trace_file.empty()) {
+    Tracer::enable();
+    Tracer::set_thread_name("main");
+  }
+
+  if (is_perf_counters) {
+    is_stats = true;
+    PerfCounters probe;
+    if (!probe.is_available()) {
+      std::cerr << std::format("Hardware performance counters are unavailable ({})", probe.error()) << std::endl;
+      is_perf_counters = false;
+    }
+  }
+
+  auto layout = *find_corpus_layout(layout_name);
+  bool is_decode = mode == "decode";
+  std::vector<Job> jobs;
+  uint64_t input_size = 0;
+  for (uint32_t i = 0; std::filesystem::exists(corpus_rib_path(corpus_dir, layout, i)); i++) {
+    Job job;
+    if (is_decode) {
+      job.inputs = {corpus_rib_path(corpus_dir, layout, i)};
+      // Complex stream is decoded into <name>_0.wav .. <name>_5.wav
+      job.output = out_dir / std::format("{}_{:04}.wav", layout.name, i);
+    } else {
+      job.inputs = corpus_wav_paths(corpus_dir, layout, i);
+      job.output = out_dir / corpus_rib_path(".", layout, i).filename();
+    }
+    for (const auto &itm : job.inputs) {
+      input_size += std::filesystem::file_size(itm);
+    }
+    jobs.push_back(job);
+  }
+  if (jobs.empty()) {
+    std::cerr << std::format("No {} files in {}", layout_name, corpus_dir.string()) << std::endl;
+    return 1;
+  }
+  std::filesystem::create_directories(out_dir);
+
+  // Every thread needs at least codec buffers of one conversion
+  if (max_memory > 0) {
+    Codec codec(layout.is_mono, layout.frequency, layout.count_files);
+    uint64_t job_memory = is_decode ? codec.decode_buffers_size() : codec.encode_buffers_size();
+    if (max_memory < job_memory) {
+      std::cerr << std::format("Memory budget is less than {} bytes needed by one conversion", job_memory)
+                << std::endl;
+      return 1;
+    }
+    if (max_memory / job_memory < nb_threads) {
+      nb_threads = (uint32_t)(max_memory / job_memory);
+      std::cerr << std::format("Memory budget allows {} thread(s)", nb_threads) << std::endl;
+    }
+  }
+
+  // Progress messages of codec would be measured too
+  NullBuffer null_buffer;
+  auto cout_buffer = std::cout.rdbuf(&null_buffer);
+  std::atomic<size_t> next_job = 0;
+  std::atomic<bool> is_failed = false;
+  std::vector<CodecStats> job_stats(jobs.size());
+  auto worker = [&](uint32_t index) {
+    if (Tracer::is_enabled()) {
+      Tracer::set_thread_name(std::format("worker {}", index));
+    }
+    // Counters count events of thread that opened them
+    std::unique_ptr<PerfCounters> perf;
+    if (is_perf_counters) {
+      perf = std::make_unique<PerfCounters>();
+    }
+    for (size_t i = next_job++; i < jobs.size() && !is_failed; i = next_job++) {
+      job_stats.at(i).perf = perf.get();
+      CodecOptions options;
+      options.max_memory = max_memory / nb_threads;
+      if (is_stats) {
+        options.stats = &job_stats.at(i);
+      }
+      Codec codec(layout.is_mono, layout.frequency, layout.count_files, options);
+      try {
+        if (is_decode) {
+          codec.decode(jobs.at(i).inputs.front(), jobs.at(i).output);
+        } else {
+          codec.encode(jobs.at(i).inputs, jobs.at(i).output);
+        }
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        is_failed = true;
+      }
+    }
+  };
+
+  auto usage_before = resource_usage();
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < nb_threads; i++) {
+    threads.emplace_back(worker, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto usage_after = resource_usage();
+  std::cout.rdbuf(cout_buffer);
+  if (is_failed) {
+    return 1;
+  }
+
+  uint64_t output_size = 0;
+  for (const auto &itm : std::filesystem::directory_iterator(out_dir)) {
+    output_size += itm.file_size();
+  }
+  std::filesystem::remove_all(out_dir);
+  if (!trace_file.empty()) {
+    Tracer::write(trace_file);
+  }
+
+  double cpu = usage_after.cpu - usage_before.cpu;
+  constexpr double megabyte = 1024 * 1024;
+  std::cout << std::format("{} {}: {} file(s), {} thread(s)\n", mode, layout_name, jobs.size(), nb_threads);
+  std::cout << std::format("  wall {:.3f} s, {:.2f} files/s\n", wall, jobs.size() / wall);
+  std::cout << std::format("  input {:.1f} MB ({:.1f} MB/s), output {:.1f} MB ({:.1f} MB/s)\n", input_size / megabyte,
+                           input_size / megabyte / wall, output_size / megabyte, output_size / megabyte / wall);
+  std::cout << std::format("  CPU {:.3f} s ({:.1f}% of wall, {:.1f}% of {} thread(s))\n", cpu, 100 * cpu / wall,
+                           100 * cpu / wall / nb_threads, nb_threads);
+  std::cout << std::format("  peak RSS {:.1f} MB", usage_after.max_rss / megabyte) << std::endl;
+
+  if (is_stats) {
+    CodecStats total;
+    for (size_t i = 0; i < jobs.size(); i++) {
+      if (is_perf_counters) {
+        std::cout << std::format("{}: {:.3f} ms, {}\n", jobs.at(i).inputs.front().filename().string(),
+                                 job_stats.at(i).total_ns() / 1e6, job_stats.at(i).total_counts().summary());
+      }
+      total += job_stats.at(i);
+    }
+    total.print(std::cout);
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * Latency from open of RIB file to its first decoded samples with cold and warm page cache. Background decoder
+ * (first frame decoded on open, rest in background thread) is compared with decoding whole substream up front.
+ */
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CLI11.hpp"
+#include "codec.h"
+#include "file_io.h"
+#include "stream_decoder.h"
+
+using Clock = std::chrono::steady_clock;
+
+/// Drop cached pages of file, so that next open reads it from disk. Returns false if not supported.
+bool drop_cache(const std::string &file) {
+#if defined(_WIN32) || !defined(POSIX_FADV_DONTNEED)
+  return false;
+#else
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool is_dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  close(fd);
+  return is_dropped;
+#endif
+}
+
+struct Latency {
+  /// Open to first sample
+  std::vector<double> first;
+  /// Open to complete substream
+  std::vector<double> complete;
+};
+
+double percentile(std::vector<double> values, double p) {
+  std::sort(values.begin(), values.end());
+  return values.at(std::min(values.size() - 1, (size_t)(p * values.size())));
+}
+
+/// Run path iterations times, it reports time points of first sample and complete substream relative to open
+Latency measure(const std::string &file, bool is_cold, uint32_t iterations,
+                const std::function<void(Clock::time_point &, Clock::time_point &)> &path) {
+  Latency latency;
+  for (uint32_t i = 0; i < iterations; i++) {
+    if (is_cold) {
+      drop_cache(file);
+    }
+    auto start = Clock::now();
+    Clock::time_point first;
+    Clock::time_point complete;
+    path(first, complete);
+    latency.first.push_back(std::chrono::duration<double, std::micro>(first - start).count());
+    latency.complete.push_back(std::chrono::duration<double, std::micro>(complete - start).count());
+  }
+  return latency;
+}
+
+int main(int argc, char *argv[]) {
+  std::string in_file;
+  uint32_t frequency = 44100;
+  bool is_mono = false;
+  bool is_complex = false;
+  uint32_t substream = 0;
+  uint32_t iterations = 50;
+
+  CLI::App app{"Open to first sample latency of RIB decoding"};
+  app.add_option("input", in_file, "Input RIB file")->required()->check(CLI::ExistingFile);
+  app.add_option("-f", frequency, "Frequency of the stream")
+      ->default_val(frequency)
+      ->check(CLI::IsMember({22050, 44100}));
+  app.add_flag("-m", is_mono, "Threats input file as Mono stream");
+  app.add_flag("-c", is_complex, "Threats input file as Complex stream");
+  app.add_option("-s,--substream", substream, "Substream to decode")->default_val(substream)->check(CLI::Range(0, 5));
+  app.add_option("-n,--iterations", iterations, "Number of iterations")
+      ->default_val(iterations)
+      ->check(CLI::PositiveNumber);
+  CLI11_PARSE(app, argc, argv);
+
+  Codec codec(is_mono, frequency, is_complex ? 6 : 1);
+  int64_t checksum = 0;
+
+  auto background_path = [&](Clock::time_point &first, Clock::time_point &complete) {
+    MappedFile file(in_file);
+    RibBackgroundDecoder decoder(file.data(), codec, substream);
+    first = Clock::now();
+    checksum += decoder.available().empty() ? 0 : decoder.available().front();
+    decoder.wait();
+    complete = Clock::now();
+  };
+  auto full_path = [&](Clock::time_point &first, Clock::time_point &complete) {
+    MappedFile file(in_file);
+    std::vector<int16_t> samples(codec.substream_samples(file.size(), substream) * codec.nb_channels());
+    codec.decode_range(file.data(), substream, 0, samples);
+    first = complete = Clock::now();
+    checksum += samples.empty() ? 0 : samples.front();
+  };
+
+  bool has_cold = drop_cache(in_file);
+  if (!has_cold) {
+    std::cout << "Page cache can't be dropped on this system, cold results are warm" << std::endl;
+  }
+  std::cout << std::format("{:<12} {:<5} {:>12} {:>12} {:>14} {:>14}\n", "path", "cache", "first p50 us",
+                           "first p99 us", "complete p50 us", "complete p99 us");
+  for (bool is_cold : {true, false}) {
+    for (const auto &[name, path] : {std::pair{"background", std::function(background_path)},
+                                     std::pair{"full decode", std::function(full_path)}}) {
+      if (!is_cold) {
+        // Warm up page cache
+        measure(in_file, false, 1, path);
+      }
+      auto latency = measure(in_file, is_cold, iterations, path);
+      std::cout << std::format("{:<12} {:<5} {:>12.1f} {:>12.1f} {:>14.1f} {:>14.1f}\n", name,
+                               is_cold ? "cold" : "warm", percentile(latency.first, 0.5),
+                               percentile(latency.first, 0.99), percentile(latency.complete, 0.5),
+                               percentile(latency.complete, 0.99));
+    }
+  }
+  std::cout << std::format("checksum {}", checksum) << std::endl;
+  return 0;
+}
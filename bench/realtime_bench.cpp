@@ -0,0 +1,180 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * Offline simulation of audio thread playing RIB streams. Each callback decodes one buffer of every stream through
+ * rib_stream_read() and mixes them, callback latency is compared against buffer period of simulated audio clock.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CLI11.hpp"
+#include "manhuntribber.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Stream {
+  rib_stream *stream = nullptr;
+  uint64_t start = 0;
+  std::vector<int16_t> buffer;
+};
+
+/// Latency histogram with power of two buckets in microseconds
+class Histogram {
+public:
+  void add(int64_t ns) {
+    size_t bucket = 0;
+    for (int64_t us = ns / 1000; us > 0 && bucket + 1 < m_buckets.size(); us >>= 1) {
+      bucket++;
+    }
+    m_buckets.at(bucket)++;
+  }
+
+  void print(std::ostream &output) const {
+    for (size_t i = 0; i < m_buckets.size(); i++) {
+      if (m_buckets.at(i) > 0) {
+        uint64_t low = i == 0 ? 0 : 1ULL << (i - 1);
+        output << std::format("    [{:>6}, {:>6}) us {:>8}\n", low, 1ULL << i, m_buckets.at(i));
+      }
+    }
+  }
+
+private:
+  std::vector<uint64_t> m_buckets = std::vector<uint64_t>(24, 0);
+};
+
+/// Fill buffer from stream, looping it at the end
+void read_looped(Stream &stream, size_t nb_samples, uint32_t nb_channels) {
+  size_t done = 0;
+  while (done < nb_samples) {
+    size_t nb_read;
+    rib_stream_read(stream.stream, stream.buffer.data() + done * nb_channels, nb_samples - done, &nb_read);
+    if (nb_read < nb_samples - done) {
+      rib_stream_seek(stream.stream, 0);
+    }
+    done += nb_read;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::string in_file;
+  uint32_t frequency = 44100;
+  bool is_mono = false;
+  bool is_complex = false;
+  uint32_t nb_extra = 0;
+  std::vector<uint32_t> buffer_sizes = {64, 128, 256, 512, 1024, 2048, 4096};
+  double seconds = 10;
+  bool is_paced = false;
+
+  CLI::App app{"Real-time playback simulation of RIB streams"};
+  app.add_option("input", in_file, "Input RIB file")->required()->check(CLI::ExistingFile);
+  app.add_option("-f", frequency, "Frequency of the stream")
+      ->default_val(frequency)
+      ->check(CLI::IsMember({22050, 44100}));
+  app.add_flag("-m", is_mono, "Threats input file as Mono stream");
+  app.add_flag("-c", is_complex, "Threats input file as Complex stream, all six substreams are played");
+  app.add_option("--extra", nb_extra, "Number of additional streams (e.g. SFX) played from substream 0")
+      ->default_val(nb_extra);
+  app.add_option("--buffers", buffer_sizes, "Buffer sizes in frames")->default_val(buffer_sizes)->delimiter(',');
+  app.add_option("--seconds", seconds, "Length of simulated playback per buffer size")->default_val(seconds);
+  app.add_flag("--paced", is_paced, "Wait for simulated clock between callbacks like real audio thread");
+  CLI11_PARSE(app, argc, argv);
+
+  uint32_t nb_channels = is_mono ? 1 : 2;
+  uint32_t nb_substreams = is_complex ? 6 : 1;
+  rib_file *file;
+  rib_status status = rib_open_file(in_file.c_str(), nb_channels, frequency, nb_substreams, &file);
+  if (status != RIB_OK) {
+    std::cerr << std::format("Can't open {}: {}", in_file, rib_status_string(status)) << std::endl;
+    return 1;
+  }
+  rib_layout layout;
+  rib_get_layout(file, &layout);
+  if (layout.nb_samples[0] == 0) {
+    std::cerr << std::format("Input file {} is empty", in_file) << std::endl;
+    return 1;
+  }
+
+  std::vector<Stream> streams(nb_substreams + nb_extra);
+  uint32_t max_buffer = *std::max_element(buffer_sizes.begin(), buffer_sizes.end());
+  for (size_t i = 0; i < streams.size(); i++) {
+    uint32_t substream = i < nb_substreams ? i : 0;
+    rib_stream_create(file, substream, &streams.at(i).stream);
+    // Extra streams start at different positions, as independent sound effects do
+    streams.at(i).start = i < nb_substreams ? 0 : (i * 12345) % layout.nb_samples[0];
+    streams.at(i).buffer.resize(max_buffer * nb_channels);
+  }
+  std::vector<int32_t> mix(max_buffer * nb_channels);
+  std::vector<int16_t> output(max_buffer * nb_channels);
+  int64_t checksum = 0;
+
+  std::cout << std::format("{} stream(s), {} channel(s), {} Hz, {:.1f} s per buffer size{}\n", streams.size(),
+                           nb_channels, frequency, seconds, is_paced ? ", paced" : "");
+
+  for (auto buffer_size : buffer_sizes) {
+    int64_t period_ns = (int64_t)buffer_size * 1'000'000'000 / frequency;
+    size_t nb_callbacks = std::max<size_t>(1, (size_t)(seconds * frequency / buffer_size));
+    std::vector<int64_t> latencies(nb_callbacks);
+    Histogram histogram;
+    size_t nb_misses = 0;
+    for (auto &stream : streams) {
+      rib_stream_seek(stream.stream, stream.start);
+    }
+
+    auto start = Clock::now();
+    for (size_t k = 0; k < nb_callbacks; k++) {
+      auto scheduled = start + std::chrono::nanoseconds(period_ns * k);
+      if (is_paced) {
+        std::this_thread::sleep_until(scheduled);
+      }
+      auto begin = Clock::now();
+
+      std::fill_n(mix.begin(), buffer_size * nb_channels, 0);
+      for (auto &stream : streams) {
+        read_looped(stream, buffer_size, nb_channels);
+        for (size_t j = 0; j < buffer_size * nb_channels; j++) {
+          mix[j] += stream.buffer[j];
+        }
+      }
+      for (size_t j = 0; j < buffer_size * nb_channels; j++) {
+        output[j] = (int16_t)std::clamp(mix[j], -32768, 32767);
+      }
+
+      auto end = Clock::now();
+      checksum += output[0];
+      latencies.at(k) = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+      histogram.add(latencies.at(k));
+      // Paced callback misses deadline when it finishes after next one is due, even if it started late
+      nb_misses += end > (is_paced ? scheduled : begin) + std::chrono::nanoseconds(period_ns);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+      return (double)latencies.at(std::min(latencies.size() - 1, (size_t)(p * latencies.size()))) / 1000;
+    };
+    double p99 = percentile(0.99);
+    std::cout << std::format("Buffer {} frames ({:.1f} us period), {} callbacks\n", buffer_size,
+                             (double)period_ns / 1000, nb_callbacks);
+    std::cout << std::format("  latency us: p50 {:.2f}  p99 {:.2f}  p99.9 {:.2f}  max {:.2f}\n", percentile(0.5), p99,
+                             percentile(0.999), (double)latencies.back() / 1000);
+    std::cout << std::format("  deadline misses: {} ({:.3f}%), p99 load {:.2f}%\n", nb_misses,
+                             100.0 * nb_misses / nb_callbacks, 100 * p99 * 1000 / period_ns);
+    std::cout << std::format("  estimated streams per core at p99: {:.0f}\n",
+                             streams.size() * period_ns / std::max(p99 * 1000, 1.0));
+    histogram.print(std::cout);
+  }
+  std::cout << std::format("checksum {}", checksum) << std::endl;
+
+  for (auto &stream : streams) {
+    rib_stream_destroy(stream.stream);
+  }
+  rib_close(file);
+  return 0;
+}
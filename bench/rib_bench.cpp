@@ -0,0 +1,174 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * Throughput of ADPCM frame kernels per chunk size (0x200 for 22050 Hz, 0x400 for 44100 Hz) and channel count. One
+ * iteration processes one frame of every channel, as Codec does for each frame of interleave.
+ */
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "adpcm_codec.h"
+#include "wav.h"
+
+namespace {
+enum class Input { Random, Fixture, Silence };
+
+constexpr size_t nb_frames = 64;
+
+/// Fixture files of given chunk size (stereo, channels are taken from their interleaves)
+std::filesystem::path fixture_path(size_t chunk_size, const char *extension) {
+  return std::filesystem::path(RIB_FIXTURES_DIR) /
+         std::format("gs-16b-2c-{}hz.{}", chunk_size == 0x200 ? 22050 : 44100, extension);
+}
+
+std::vector<char> read_file(const std::filesystem::path &file) {
+  std::ifstream input(file, std::ios::binary);
+  return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+}
+
+/// Encoded frames, frame k of channel ch is at (k * nb_channels + ch) * chunk_size
+std::vector<int8_t> make_frames(Input input, size_t chunk_size, size_t nb_channels) {
+  std::vector<int8_t> frames(nb_frames * nb_channels * chunk_size, 0);
+  if (input == Input::Random) {
+    std::mt19937 random(chunk_size * nb_channels);
+    std::uniform_int_distribution<int> byte(-128, 127);
+    std::uniform_int_distribution<int> step_index(0, 88);
+    for (size_t pos = 0; pos < frames.size(); pos += chunk_size) {
+      for (size_t j = 0; j < chunk_size; j++) {
+        frames[pos + j] = (int8_t)byte(random);
+      }
+      frames[pos + 2] = (int8_t)step_index(random);
+      frames[pos + 3] = 0;
+    }
+  } else if (input == Input::Fixture) {
+    auto rib = read_file(fixture_path(chunk_size, "rib"));
+    size_t frames_in_interleave = 0x10000 / chunk_size;
+    for (size_t k = 0; k < nb_frames; k++) {
+      for (size_t ch = 0; ch < nb_channels; ch++) {
+        size_t pos = (k / frames_in_interleave * 2 + ch) * 0x10000 + k % frames_in_interleave * chunk_size;
+        std::copy_n(rib.begin() + pos, chunk_size, frames.begin() + (k * nb_channels + ch) * chunk_size);
+      }
+    }
+  }
+  return frames;
+}
+
+/// PCM frames of channels (not interleaved), frame k of channel ch is at (k * nb_channels + ch) * frame_samples
+std::vector<int16_t> make_samples(Input input, size_t chunk_size, size_t nb_channels) {
+  size_t frame_samples = 2 * (chunk_size - 4) + 1;
+  std::vector<int16_t> samples(nb_frames * nb_channels * frame_samples, 0);
+  if (input == Input::Random) {
+    std::mt19937 random(chunk_size * nb_channels);
+    std::uniform_int_distribution<int> sample(-32768, 32767);
+    for (auto &itm : samples) {
+      itm = (int16_t)sample(random);
+    }
+  } else if (input == Input::Fixture) {
+    auto wav = read_file(fixture_path(chunk_size, "wav"));
+    auto info = parse_wav(wav);
+    auto pcm = reinterpret_cast<const int16_t *>(wav.data() + info->data_offset);
+    size_t nb_pcm = info->data_size / 4;
+    for (size_t k = 0; k < nb_frames; k++) {
+      for (size_t ch = 0; ch < nb_channels; ch++) {
+        for (size_t j = 0; j < frame_samples; j++) {
+          samples[(k * nb_channels + ch) * frame_samples + j] = pcm[(k * frame_samples + j) % nb_pcm * 2 + ch];
+        }
+      }
+    }
+  }
+  return samples;
+}
+
+void set_counters(benchmark::State &state, size_t chunk_size, size_t nb_channels) {
+  constexpr const char *input_names[] = {"random", "fixture", "silence"};
+  state.SetLabel(input_names[state.range(2)]);
+  size_t frame_samples = 2 * (chunk_size - 4) + 1;
+  state.SetBytesProcessed((int64_t)(state.iterations() * nb_channels * chunk_size));
+  state.counters["samples/s"] =
+      benchmark::Counter((double)(state.iterations() * nb_channels * frame_samples), benchmark::Counter::kIsRate);
+}
+
+void decode_frame(benchmark::State &state) {
+  size_t chunk_size = state.range(0);
+  size_t nb_channels = state.range(1);
+  auto frames = make_frames((Input)state.range(2), chunk_size, nb_channels);
+  size_t frame_samples = 2 * (chunk_size - 4) + 1;
+  std::vector<int16_t> output(frame_samples);
+  std::vector<int16_t> interleaved(frame_samples * nb_channels);
+  ADPCMChannelStatus channel_status{};
+
+  size_t k = 0;
+  for (auto _ : state) {
+    for (size_t ch = 0; ch < nb_channels; ch++) {
+      auto frame = std::span<const int8_t>(frames).subspan((k * nb_channels + ch) * chunk_size, chunk_size);
+      adpcm_rib_decode_frame(frame, output, channel_status);
+      for (size_t j = 0; j < frame_samples; j++) {
+        interleaved[j * nb_channels + ch] = output[j];
+      }
+    }
+    benchmark::DoNotOptimize(interleaved.data());
+    k = (k + 1) % nb_frames;
+  }
+  set_counters(state, chunk_size, nb_channels);
+}
+
+void encode_frame(benchmark::State &state) {
+  size_t chunk_size = state.range(0);
+  size_t nb_channels = state.range(1);
+  auto samples = make_samples((Input)state.range(2), chunk_size, nb_channels);
+  size_t frame_samples = 2 * (chunk_size - 4) + 1;
+  std::vector<int8_t> output(chunk_size);
+  std::vector<ADPCMChannelStatus> channel_status(nb_channels, ADPCMChannelStatus{});
+
+  size_t k = 0;
+  for (auto _ : state) {
+    for (size_t ch = 0; ch < nb_channels; ch++) {
+      auto frame = std::span<const int16_t>(samples).subspan((k * nb_channels + ch) * frame_samples, frame_samples);
+      adpcm_rib_encode_frame(channel_status.at(ch), frame, output);
+      benchmark::DoNotOptimize(output.data());
+    }
+    k = (k + 1) % nb_frames;
+  }
+  set_counters(state, chunk_size, nb_channels);
+}
+
+/// Zero check used by silent frame fast paths (SSE2 when available)
+void is_silent_frame(benchmark::State &state) {
+  size_t chunk_size = state.range(0);
+  size_t nb_channels = state.range(1);
+  auto frames = make_frames((Input)state.range(2), chunk_size, nb_channels);
+
+  size_t k = 0;
+  for (auto _ : state) {
+    for (size_t ch = 0; ch < nb_channels; ch++) {
+      auto frame = std::span<const int8_t>(frames).subspan((k * nb_channels + ch) * chunk_size, chunk_size);
+      benchmark::DoNotOptimize(adpcm_rib_is_silent_frame(frame));
+    }
+    k = (k + 1) % nb_frames;
+  }
+  set_counters(state, chunk_size, nb_channels);
+}
+
+void frame_arguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"chunk", "channels", "input"});
+  for (int64_t chunk_size : {0x200, 0x400}) {
+    for (int64_t nb_channels : {1, 2}) {
+      for (auto input : {Input::Random, Input::Fixture, Input::Silence}) {
+        benchmark->Args({chunk_size, nb_channels, (int64_t)input});
+      }
+    }
+  }
+}
+} // namespace
+
+BENCHMARK(decode_frame)->Apply(frame_arguments);
+BENCHMARK(encode_frame)->Apply(frame_arguments);
+BENCHMARK(is_silent_frame)->Apply(frame_arguments);
+
+BENCHMARK_MAIN();
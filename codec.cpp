@@ -1,16 +1,22 @@
 /* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
-#include <cmath>
+#include <algorithm>
+#include <cstring>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 #include "adpcm_codec.h"
 #include "byteswap.h"
 #include "codec.h"
+#include "file_io.h"
+#include "stream_decoder.h"
+#include "trace.h"
 
-Codec::Codec(bool is_mono, uint32_t frequency, uint32_t count_files) {
+Codec::Codec(bool is_mono, uint32_t frequency, uint32_t count_files, const CodecOptions &options) {
+  m_options = options;
   m_count_files = count_files;
   m_frequency = frequency;
   m_chunk_size = (m_frequency == 22050) ? 0x200 : 0x400;
@@ -22,172 +28,959 @@ Codec::Codec(bool is_mono, uint32_t frequency, uint32_t count_files) {
 }
 
 void Codec::decode(const std::filesystem::path &rib_file, const std::filesystem::path& wav_file) const {
+  bool is_stdin = rib_file == "-";
   std::filesystem::path wav_filename = wav_file;
   if (wav_filename.empty()) {
-    (wav_filename = rib_file).replace_extension("wav");
+    if (is_stdin) {
+      wav_filename = "-";
+    } else {
+      (wav_filename = rib_file).replace_extension("wav");
+    }
+  }
+  bool is_stdout = wav_filename == "-";
+  // Keep stdout clean for decoded data
+  std::ostream &log = is_stdout ? std::cerr : std::cout;
+
+  if (is_stdout && m_count_files > 1) {
+    throw std::runtime_error("Complex stream can't be decoded to stdout");
   }
+
+  // Budget is checked before outputs are created
+  uint64_t window = input_window(decode_buffers_size());
+  TraceSpan trace_span("decode");
+  CodecStats *stats = m_options.stats;
+  MemoryMeter memory_meter(stats);
+  PhaseTimer open_timer(stats, Phase::Open);
   std::vector<std::pair<std::filesystem::path, std::ofstream>> output_files;
-  if (m_count_files == 1) {
+  std::vector<std::ostream *> outputs;
+  if (is_stdout) {
+    set_binary_mode(stdout);
+    outputs.push_back(&std::cout);
+  } else if (m_count_files == 1) {
     output_files.emplace_back(wav_filename, std::ofstream(wav_filename, std::ios::binary));
   } else {
     for (uint32_t i = 0; i < m_count_files; i++) {
-      std::filesystem::path construct_file =
-          wav_filename.parent_path() / std::format("{}_{}", wav_filename.stem().string(), i);
-      construct_file.replace_extension(wav_filename.extension());
+      std::filesystem::path construct_file = substream_path(wav_filename, i);
       output_files.emplace_back(construct_file, std::ofstream(construct_file, std::ios::binary));
     }
   }
-  std::ifstream input_file(rib_file, std::ios::binary | std::ios::ate);
 
-  if (!input_file.is_open()) {
-    std::cout << std::format("Can't open input file for reading {}", rib_file.string()) << std::endl;
-    exit(1);
+  std::unique_ptr<MappedFile> input_file;
+  std::span<const char> data;
+  if (is_stdin) {
+    set_binary_mode(stdin);
+  } else {
+    input_file = std::make_unique<MappedFile>(rib_file);
+    if (!input_file->is_open()) {
+      throw std::runtime_error(std::format("Can't open input file for reading {}", rib_file.string()));
+    }
+    data = input_file->data();
   }
 
-  for (auto const &itm : output_files) {
+  for (auto &itm : output_files) {
     if (!itm.second.is_open()) {
-      std::cout << std::format("Can't open output file for writing {}", itm.first.string()) << std::endl;
-      exit(1);
+      throw std::runtime_error(std::format("Can't open output file for writing {}", itm.first.string()));
     }
+    outputs.push_back(&itm.second);
+  }
+  open_timer.stop();
+
+  log << std::format("Decoding {} to {} ... ", rib_file.string(), wav_filename.string());
+
+  PhaseTimer header_timer(stats, Phase::Header);
+  size_t interleave_size = m_nb_channels * m_interleave;
+  size_t frame_size_decoded = m_nb_chunk_decoded * m_nb_channels * sizeof(int16_t);
+  // Partial trailing interleave is decoded as if it was padded with zeros
+  size_t nb_interleaves = (data.size() + interleave_size - 1) / interleave_size;
+  // Length of stdin is unknown, so is its trailing padding
+  std::vector<size_t> content_frames(m_count_files, SIZE_MAX);
+  if (!is_stdin) {
+    content_frames = count_content_frames(data);
   }
 
-  std::cout << std::format("Decoding {} to {} ... ", rib_file.string(), wav_filename.string());
+  // Size of output is known before decoding, so header is written first and output is strictly sequential
+  for (uint32_t i = 0; i < outputs.size() && !m_options.raw_output; i++) {
+    std::optional<uint64_t> data_size;
+    if (!is_stdin) {
+      size_t nb_rounds = (nb_interleaves + m_count_files - 1 - i) / m_count_files;
+      size_t nb_frames = m_options.trim_padding ? content_frames.at(i) : nb_rounds * m_nb_chunks_in_interleave;
+      data_size = nb_frames * frame_size_decoded;
+    }
+    auto wave_header = make_wav_header(m_nb_channels, m_frequency, data_size);
+    outputs.at(i)->write(wave_header.data(), wave_header.size());
+    if (stats) {
+      stats->output_bytes += wave_header.size();
+    }
+  }
+  header_timer.stop();
+
+  CodecBuffer<int8_t> buffer;
+  CodecBuffer<int16_t> samples;
+  CodecBuffer<int16_t> planar;
+  // End of input part already released
+  size_t released = 0;
+  for (size_t i = 0; is_stdin || i < nb_interleaves; i++) {
+    TraceSpan interleave_span("decode interleave", (int64_t)i);
+    std::span<const int8_t> interleave;
+    PhaseTimer read_timer(stats, Phase::Read);
+    if (is_stdin) {
+      buffer.assign(interleave_size, 0);
+      std::cin.read(reinterpret_cast<char *>(buffer.data()), interleave_size);
+      if (std::cin.gcount() == 0) {
+        break;
+      }
+      interleave = buffer;
+    } else {
+      interleave = interleave_at(data, i, buffer);
+      if (stats) {
+        prefault({reinterpret_cast<const char *>(interleave.data()), interleave.size()});
+      }
+    }
+    read_timer.stop();
+    if (stats) {
+      stats->input_bytes += is_stdin ? (size_t)std::cin.gcount()
+                                     : std::min(interleave_size, data.size() - i * interleave_size);
+    }
+
+    size_t round = i / m_count_files;
+    size_t frames = content_frames.at(i % m_count_files);
+    // Frames after content are only padding, no need to decode them
+    frames = std::min<size_t>(m_nb_chunks_in_interleave,
+                              frames - std::min(frames, round * m_nb_chunks_in_interleave));
+    if (frames == 0 && m_options.trim_padding) {
+      continue;
+    }
 
-  size_t input_size = input_file.tellg();
-  input_file.seekg(0, std::ios::beg);
+    decode_interleave(interleave, frames, samples, planar, i % m_count_files);
 
-  size_t nb_interleaves = input_size / (m_nb_channels * m_interleave);
-  uint32_t nb_chunks = m_interleave / m_chunk_size;
+    size_t nb_samples = m_options.trim_padding ? frames * m_nb_chunk_decoded * m_nb_channels : samples.size();
+    PhaseTimer write_timer(stats, Phase::Write);
+    outputs.at(i % m_count_files)->write(reinterpret_cast<char *>(samples.data()), nb_samples * sizeof(int16_t));
+    write_timer.stop();
+    if (stats) {
+      stats->output_bytes += nb_samples * sizeof(int16_t);
+      stats->samples += nb_samples / m_nb_channels;
+    }
 
+    // Decoded pages of input are released to stay within memory budget
+    size_t decoded = std::min((i + 1) * interleave_size, data.size());
+    if (!is_stdin && decoded - released > window) {
+      size_t size = input_file->release(data.subspan(released, decoded - released));
+      released = decoded;
+      if (stats) {
+        stats->released_bytes += size;
+      }
+    }
+  }
 
+  PhaseTimer finalize_timer(stats, Phase::Finalize);
   for (auto &itm : output_files) {
-    itm.second.seekp(sizeof(wav_hdr), std::ios::beg);
+    // Unknown sizes are fixed up in regular files. Header can't grow to RF64 in place, so output over 4 GiB keeps
+    // streaming-style sizes.
+    if (is_stdin && !m_options.raw_output) {
+      uint64_t size = itm.second.tellp();
+      auto wave_header = make_wav_header(m_nb_channels, m_frequency, size - sizeof(wav_hdr));
+      if (wave_header.size() == sizeof(wav_hdr)) {
+        itm.second.seekp(0, std::ios::beg);
+        itm.second.write(wave_header.data(), wave_header.size());
+      }
+    }
+    itm.second.close();
+  }
+  std::cout.flush();
+  finalize_timer.stop();
+  if (stats) {
+    stats->nb_files++;
   }
 
-  for (int i = 0; i < nb_interleaves; i++) {
-    std::vector<std::shared_ptr<std::vector<int16_t>>> outputs(m_nb_channels);
-    for (auto &out : outputs) {
-      out = std::make_shared<std::vector<int16_t>>();
+  if (is_stdin) {
+    log << "done!" << std::endl;
+    return;
+  }
+  std::string content_lengths;
+  for (auto frames : content_frames) {
+    content_lengths += std::format("{}{:.2f}", content_lengths.empty() ? "" : ", ",
+                                   (double)(frames * m_nb_chunk_decoded) / m_frequency);
+  }
+  log << std::format("done! (content length {} s)", content_lengths) << std::endl;
+}
+
+void Codec::encode(std::vector<std::filesystem::path> in_files, std::filesystem::path rib_file,
+                   uint64_t stdin_size) const {
+  const auto& in_file = in_files.front();
+
+  if (rib_file.empty()) {
+    if (in_file == "-") {
+      rib_file = "-";
+    } else {
+      (rib_file = in_file).replace_extension("rib");
     }
+  }
+  bool is_stdout = rib_file == "-";
+  // Keep stdout clean for encoded data
+  std::ostream &log = is_stdout ? std::cerr : std::cout;
+
+  // Budget is checked before output is created
+  (void)input_window(encode_buffers_size());
+  TraceSpan trace_span("encode");
+  CodecStats *stats = m_options.stats;
+  MemoryMeter memory_meter(stats);
+  std::vector<std::unique_ptr<MappedFile>> input_files;
+  std::vector<ByteSource> inputs;
 
-    for (int ch = 0; ch < m_nb_channels; ch++) {
-      for (int j = 0; j < nb_chunks; j++) {
-        std::vector<int8_t> input_buffer(m_chunk_size);
-        input_file.read(reinterpret_cast<char *>(input_buffer.data()), m_chunk_size);
-        adpcm_rib_decode_frame(std::make_shared<std::vector<int8_t>>(input_buffer), outputs.at(ch));
-      }
+  for (const auto &itm : in_files) {
+    if (itm == "-") {
+      // Header of stdin is already read by caller to get stream layout, chunks after "data" are not PCM
+      set_binary_mode(stdin);
+      inputs.emplace_back(std::cin, stdin_size);
+      continue;
     }
-    for (int j = 0; j < m_nb_chunk_decoded * nb_chunks; j++) {
-      for (int ch = 0; ch < m_nb_channels; ch++) {
-        int16_t r = UTILS::convert_le(outputs.at(ch)->at(j));
-        output_files.at(i % m_count_files).second.write(reinterpret_cast<char *>(&r), 2);
-      }
+    PhaseTimer open_timer(stats, Phase::Open);
+    auto &input_file = input_files.emplace_back(std::make_unique<MappedFile>(itm));
+    open_timer.stop();
+    PhaseTimer header_timer(stats, Phase::Header);
+    inputs.emplace_back(*input_file, pcm_data(*input_file, itm));
+  }
+
+  PhaseTimer open_timer(stats, Phase::Open);
+  std::ofstream output_file;
+  if (is_stdout) {
+    set_binary_mode(stdout);
+  } else {
+    output_file.open(rib_file, std::ios::binary);
+    if (!output_file.is_open()) {
+      throw std::runtime_error(std::format("Can't open output file for writing {}", rib_file.string()));
     }
   }
+  open_timer.stop();
 
-  for (int i = 0; i < m_count_files; i++) {
-    size_t size = output_files.at(i).second.tellp();
-    // Write wave header with actual sizes
-    wav_hdr wave_header;
-    wave_header.ChunkSize = UTILS::convert_le(size - 8);
-    wave_header.Subchunk2Size = UTILS::convert_le(size - 44);
-    wave_header.NumOfChan = UTILS::convert_le(m_nb_channels);
+  log << std::format("Encoding {} to {} ... ", in_file.string(), rib_file.string());
 
-    wave_header.SamplesPerSec = UTILS::convert_le(m_frequency);
-    wave_header.blockAlign = m_nb_channels * 2;
-    wave_header.bytesPerSec = UTILS::convert_le(m_frequency * m_nb_channels * 2);
+  encode(inputs, is_stdout ? std::cout : output_file);
 
-    output_files.at(i).second.seekp(0, std::ios::beg);
-    output_files.at(i).second.write(reinterpret_cast<char *>(&wave_header), sizeof(wav_hdr));
-    output_files.at(i).second.close();
+  PhaseTimer finalize_timer(stats, Phase::Finalize);
+  output_file.close();
+  std::cout.flush();
+  finalize_timer.stop();
+  if (stats) {
+    stats->nb_files++;
   }
+  log << "done!" << std::endl;
+}
 
-  input_file.close();
-  std::cout << "done!" << std::endl;
+void Codec::encode(const std::vector<std::istream *> &inputs, std::ostream &output) const {
+  std::vector<ByteSource> sources;
+  for (auto input : inputs) {
+    sources.emplace_back(*input);
+  }
+  encode(sources, output);
 }
 
-void Codec::encode(std::vector<std::filesystem::path> in_files, std::filesystem::path rib_file) const {
-  const auto& in_file = in_files.front();
+void Codec::encode(const std::vector<std::span<const char>> &inputs, std::ostream &output) const {
+  if (inputs.size() != m_count_files) {
+    throw std::runtime_error(std::format("Expected {} input streams, got {}", m_count_files, inputs.size()));
+  }
+  std::vector<ByteSource> sources(inputs.begin(), inputs.end());
+  encode(sources, output);
+}
+
+uint64_t Codec::decoded_size(std::span<const std::byte> rib, uint32_t substream) const {
+  std::span<const char> data(reinterpret_cast<const char *>(rib.data()), rib.size());
+  uint64_t data_size = substream_frames(data, substream) * m_nb_chunk_decoded * m_nb_channels * sizeof(int16_t);
+  if (m_options.raw_output) {
+    return data_size;
+  }
+  return make_wav_header(m_nb_channels, m_frequency, data_size).size() + data_size;
+}
+
+void Codec::decode(std::span<const std::byte> rib, std::vector<std::byte> &output, uint32_t substream) const {
+  output.resize(decoded_size(rib, substream));
+  decode(rib, std::span<std::byte>(output), substream);
+}
+
+size_t Codec::decode(std::span<const std::byte> rib, std::span<std::byte> output, uint32_t substream) const {
+  // Data in memory is owned by caller, only buffers are limited by budget
+  (void)input_window(decode_buffers_size());
+  std::span<const char> data(reinterpret_cast<const char *>(rib.data()), rib.size());
+  size_t nb_frames = substream_frames(data, substream);
+  size_t frame_size_decoded = m_nb_chunk_decoded * m_nb_channels * sizeof(int16_t);
+  uint64_t data_size = nb_frames * frame_size_decoded;
+
+  std::vector<char> header;
+  if (!m_options.raw_output) {
+    header = make_wav_header(m_nb_channels, m_frequency, data_size);
+  }
+  if (output.size() < header.size() + data_size) {
+    throw std::runtime_error(std::format("Output buffer is too small ({} bytes, {} needed)", output.size(),
+                                         header.size() + data_size));
+  }
+  std::copy(header.begin(), header.end(), reinterpret_cast<char *>(output.data()));
+
+  CodecBuffer<int8_t> buffer;
+  CodecBuffer<int16_t> samples;
+  CodecBuffer<int16_t> planar;
+  size_t position = header.size();
+  for (size_t i = substream, round = 0; round * m_nb_chunks_in_interleave < nb_frames; i += m_count_files, round++) {
+    size_t frames = std::min<size_t>(m_nb_chunks_in_interleave, nb_frames - round * m_nb_chunks_in_interleave);
+    TraceSpan interleave_span("decode interleave", (int64_t)i);
+    decode_interleave(interleave_at(data, i, buffer), frames, samples, planar, substream);
+    std::memcpy(output.data() + position, samples.data(), frames * frame_size_decoded);
+    position += frames * frame_size_decoded;
+  }
+  return position;
+}
+
+uint64_t Codec::encoded_size(const std::vector<std::span<const std::byte>> &inputs) const {
+  size_t input_size = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    std::span<const char> file(reinterpret_cast<const char *>(inputs.at(i).data()), inputs.at(i).size());
+    input_size = std::max(input_size, pcm_data(file, std::format("#{}", i)).size());
+  }
+  return interleaves_count(input_size) * m_count_files * m_nb_channels * m_interleave;
+}
+
+void Codec::encode(const std::vector<std::span<const std::byte>> &inputs, std::vector<std::byte> &output) const {
+  output.resize(encoded_size(inputs));
+  encode(inputs, std::span<std::byte>(output));
+}
+
+size_t Codec::encode(const std::vector<std::span<const std::byte>> &inputs, std::span<std::byte> output) const {
+  if (inputs.size() != m_count_files) {
+    throw std::runtime_error(std::format("Expected {} input files, got {}", m_count_files, inputs.size()));
+  }
+  std::vector<ByteSource> sources;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    std::span<const char> file(reinterpret_cast<const char *>(inputs.at(i).data()), inputs.at(i).size());
+    sources.emplace_back(pcm_data(file, std::format("#{}", i)));
+  }
+
+  SpanWriter buffer({reinterpret_cast<char *>(output.data()), output.size()});
+  std::ostream stream(&buffer);
+  encode(sources, stream);
+  if (!stream) {
+    throw std::runtime_error(std::format("Output buffer is too small ({} bytes, {} needed)", output.size(),
+                                         encoded_size(inputs)));
+  }
+  return buffer.size();
+}
+
+uint64_t Codec::substream_samples(uint64_t rib_size, uint32_t substream) const {
+  uint64_t interleave_size = m_nb_channels * m_interleave;
+  uint64_t nb_interleaves = (rib_size + interleave_size - 1) / interleave_size;
+  uint64_t nb_rounds = (nb_interleaves + m_count_files - 1 - substream) / m_count_files;
+  return nb_rounds * m_nb_chunks_in_interleave * m_nb_chunk_decoded;
+}
+
+size_t Codec::decode_range(std::span<const char> rib, uint32_t substream, uint64_t first_sample,
+                           std::span<int16_t> output) const {
+  RibStreamDecoder decoder(rib, *this, substream);
+  decoder.seek(first_sample);
+  size_t count = std::min<uint64_t>(output.size() / m_nb_channels, decoder.length() - decoder.position());
+  output = output.first(count * m_nb_channels);
+  decoder.read(output);
+  std::transform(output.begin(), output.end(), output.begin(), [this](int16_t sample) { return convert_pcm(sample); });
+  return count;
+}
+
+void Codec::encode(std::vector<ByteSource> &inputs, std::ostream &output) const {
+  std::vector<std::vector<ADPCMChannelStatus>> channel_status(m_count_files,
+                                                              std::vector<ADPCMChannelStatus>(m_nb_channels));
+  std::vector<CodecBuffer<int16_t>> buffers(m_count_files);
+  std::vector<std::span<const int16_t>> samples(m_count_files);
+  CodecBuffer<int16_t> planar;
+  CodecBuffer<int8_t> encoded;
+
+  CodecStats *stats = m_options.stats;
+  // Resident part of mapped inputs is split evenly between them
+  uint64_t window = input_window(encode_buffers_size()) / m_count_files;
+
+  // All substreams of complex stream have same length, so interleave is emitted once whole round is read
+  for (size_t round = 0;; round++) {
+    bool has_data = false;
+    PhaseTimer read_timer(stats, Phase::Read);
+    for (uint32_t i = 0; i < m_count_files; i++) {
+      size_t size;
+      samples.at(i) = read_interleave(inputs.at(i), buffers.at(i), size);
+      has_data |= size > 0;
+      if (stats) {
+        prefault({reinterpret_cast<const char *>(samples.at(i).data()), samples.at(i).size_bytes()});
+        stats->input_bytes += size;
+        stats->samples += size / (m_nb_channels * sizeof(int16_t));
+      }
+    }
+    read_timer.stop();
+    if (!has_data) {
+      break;
+    }
+
+    for (uint32_t i = 0; i < m_count_files; i++) {
+      TraceSpan interleave_span("encode interleave", (int64_t)(round * m_count_files + i));
+      encode_interleave(samples.at(i), channel_status.at(i), planar, encoded, i);
+      PhaseTimer write_timer(stats, Phase::Write);
+      output.write(reinterpret_cast<char *>(encoded.data()), encoded.size());
+      write_timer.stop();
+      if (stats) {
+        stats->output_bytes += encoded.size();
+      }
+    }
+
+    // Encoded pages of mapped inputs are released to stay within memory budget
+    for (auto &input : inputs) {
+      size_t size = input.release_read(window);
+      if (stats) {
+        stats->released_bytes += size;
+      }
+    }
+  }
+}
+
+size_t Codec::encode_incremental(const std::vector<std::filesystem::path> &in_files,
+                                 std::filesystem::path rib_file) const {
+  const auto &in_file = in_files.front();
 
   if (rib_file.empty()) {
     (rib_file = in_file).replace_extension("rib");
   }
-  std::vector<std::pair<std::filesystem::path, std::ifstream>> input_files;
-  std::ofstream output_file(rib_file, std::ios::binary);
-
+  std::filesystem::path manifest_file = rib_file;
+  manifest_file += ".manifest";
 
+  std::vector<std::unique_ptr<MappedFile>> input_files;
+  std::vector<ByteSource> inputs;
+  size_t input_size = 0;
   for (const auto &itm : in_files) {
-    input_files.emplace_back(itm, std::ifstream(itm, std::ios::binary | std::ios::ate));
+    auto &input_file = input_files.emplace_back(std::make_unique<MappedFile>(itm));
+    auto data = pcm_data(*input_file, itm);
+    input_size = std::max(input_size, data.size());
+    inputs.emplace_back(data);
   }
 
-  for (auto const &itm : input_files) {
+  if (!std::filesystem::exists(rib_file)) {
+    std::ofstream(rib_file, std::ios::binary);
+  }
+  std::fstream rib(rib_file, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+
+  if (!rib.is_open()) {
+    throw std::runtime_error(std::format("Can't open output file for writing {}", rib_file.string()));
+  }
+
+  std::cout << std::format("Incrementally encoding {} to {} ... ", in_file.string(), rib_file.string());
+
+  size_t interleave_size = m_nb_channels * m_interleave;
+  size_t rib_size = rib.tellg();
+  size_t nb_old_interleaves = rib_size / interleave_size;
+
+  size_t nb_interleaves = interleaves_count(input_size) * m_count_files;
+
+  // Without manifest every interleave is encoded and compared against existing one
+  std::vector<InterleaveHashes> old_hashes = read_manifest(manifest_file, rib_size);
+  std::vector<InterleaveHashes> hashes(nb_interleaves);
+
+  std::vector<std::vector<ADPCMChannelStatus>> channel_status(m_count_files,
+                                                              std::vector<ADPCMChannelStatus>(m_nb_channels));
+  // Encoder state of substream differs from the one stored in existing file
+  std::vector<bool> is_diverged(m_count_files, false);
+  CodecBuffer<int16_t> buffer;
+  CodecBuffer<int16_t> planar;
+  CodecBuffer<int8_t> output;
+  CodecBuffer<int8_t> existing(interleave_size);
+  size_t nb_rewritten = 0;
+
+  for (size_t i = 0; i < nb_interleaves; i++) {
+    uint32_t substream = i % m_count_files;
+    auto &status = channel_status.at(substream);
+
+    size_t size;
+    auto samples = read_interleave(inputs.at(substream), buffer, size);
+    hashes.at(i).pcm = hash_interleave(samples);
+
+    bool is_existing = i < nb_old_interleaves;
+    if (is_existing) {
+      rib.seekg(i * interleave_size);
+      rib.read(reinterpret_cast<char *>(existing.data()), interleave_size);
+      hashes.at(i).rib = hash_interleave(existing);
+    }
+    // RIB may have been rewritten by other means since manifest was written, so its data must match too
+    if (is_existing && !is_diverged.at(substream) && i < old_hashes.size() && old_hashes.at(i) == hashes.at(i)) {
+      continue;
+    }
+    if (!is_diverged.at(substream)) {
+      if (is_existing) {
+        // Seed encoder from step index stored in existing frame headers
+        for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+          status.at(ch).step_index = std::clamp<int16_t>(existing.at(ch * m_interleave + 2), 0, 88);
+        }
+      } else if (i >= m_count_files) {
+        read_final_status(rib, i - m_count_files, status);
+      }
+    }
+
+    encode_interleave(samples, status, planar, output, substream);
+
+    if (!is_existing || output != existing) {
+      rib.seekp(i * interleave_size);
+      rib.write(reinterpret_cast<char *>(output.data()), interleave_size);
+      hashes.at(i).rib = hash_interleave(output);
+      nb_rewritten++;
+    }
+
+    // Stream reconverges once encoder state matches the one stored in next existing interleave
+    size_t next = i + m_count_files;
+    is_diverged.at(substream) = false;
+    if (next < nb_old_interleaves && next < nb_interleaves) {
+      for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+        char step_index;
+        rib.seekg(next * interleave_size + ch * m_interleave + 2);
+        rib.get(step_index);
+        if (status.at(ch).step_index != step_index) {
+          is_diverged.at(substream) = true;
+        }
+      }
+    }
+  }
+
+  if (!rib.good()) {
+    throw std::runtime_error(std::format("Can't write to output file {}", rib_file.string()));
+  }
+  rib.close();
+
+  if (nb_interleaves < nb_old_interleaves) {
+    std::filesystem::resize_file(rib_file, nb_interleaves * interleave_size);
+  }
+  write_manifest(manifest_file, nb_interleaves * interleave_size, hashes);
+
+  std::cout << std::format("done! ({} of {} interleaves rewritten)", nb_rewritten, nb_interleaves) << std::endl;
+  return nb_rewritten;
+}
+
+void Codec::demux(const std::filesystem::path &rib_file, const std::filesystem::path &out_file) const {
+  std::filesystem::path rib_filename = out_file;
+  if (rib_filename.empty()) {
+    rib_filename = rib_file;
+  }
+  MappedFile input_file(rib_file);
+
+  if (!input_file.is_open()) {
+    throw std::runtime_error(std::format("Can't open input file for reading {}", rib_file.string()));
+  }
+
+  std::vector<std::pair<std::filesystem::path, std::ofstream>> output_files;
+  for (uint32_t i = 0; i < m_count_files; i++) {
+    std::filesystem::path construct_file = substream_path(rib_filename, i);
+    output_files.emplace_back(construct_file, std::ofstream(construct_file, std::ios::binary));
+  }
+
+  for (auto const &itm : output_files) {
     if (!itm.second.is_open()) {
-      std::cout << std::format("Can't open input file for writing {}", itm.first.string()) << std::endl;
-      exit(1);
+      throw std::runtime_error(std::format("Can't open output file for writing {}", itm.first.string()));
     }
   }
 
+  std::cout << std::format("Demuxing {} to {} ... ", rib_file.string(), rib_filename.string());
+
+  // Interleaves are written straight from mapped input
+  size_t interleave_size = m_nb_channels * m_interleave;
+  auto data = input_file.data();
+  for (size_t i = 0; i * interleave_size < data.size(); i++) {
+    auto interleave = data.subspan(i * interleave_size, std::min(interleave_size, data.size() - i * interleave_size));
+    output_files.at(i % m_count_files).second.write(interleave.data(), interleave.size());
+  }
+
+  for (auto &itm : output_files) {
+    itm.second.close();
+  }
+  std::cout << "done!" << std::endl;
+}
+
+void Codec::mux(const std::vector<std::filesystem::path> &in_files, const std::filesystem::path &rib_file) const {
+  if (in_files.size() != m_count_files) {
+    throw std::runtime_error(std::format("Expected {} input files, got {}", m_count_files, in_files.size()));
+  }
+
+  size_t interleave_size = m_nb_channels * m_interleave;
+  std::vector<std::unique_ptr<MappedFile>> input_files;
+  size_t nb_rounds = 0;
+
+  for (const auto &itm : in_files) {
+    auto &input_file = input_files.emplace_back(std::make_unique<MappedFile>(itm));
+    if (!input_file->is_open()) {
+      throw std::runtime_error(std::format("Can't open input file for reading {}", itm.string()));
+    }
+    if (input_file->size() % interleave_size != 0) {
+      throw std::runtime_error(std::format("Input file {} is not aligned to interleave size", itm.string()));
+    }
+    nb_rounds = std::max(nb_rounds, input_file->size() / interleave_size);
+  }
+
+  std::ofstream output_file(rib_file, std::ios::binary);
+
   if (!output_file.is_open()) {
-    std::cout << std::format("Can't open output file for writing {}", rib_file.string()) << std::endl;
-    exit(1);
+    throw std::runtime_error(std::format("Can't open output file for writing {}", rib_file.string()));
   }
 
-  std::cout << std::format("Encoding {} to {} ... ", in_file.string(), rib_file.string());
+  std::cout << std::format("Muxing {} to {} ... ", in_files.front().string(), rib_file.string());
 
-  size_t input_size = 0;
-  for (auto const &itm : input_files) {
-    input_size = std::max(input_size, (size_t)input_files.front().second.tellg() - sizeof(wav_hdr));
+  // Restore encoder state at the end of each stream, so padding is the same as encoder would produce
+  std::vector<std::vector<ADPCMChannelStatus>> channel_status(m_count_files,
+                                                              std::vector<ADPCMChannelStatus>(m_nb_channels));
+  CodecBuffer<int16_t> decoded(m_nb_chunk_decoded);
+  for (uint32_t i = 0; i < m_count_files; i++) {
+    auto data = input_files.at(i)->data();
+    if (data.empty()) {
+      continue;
+    }
+    for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+      auto frame = data.subspan(data.size() - interleave_size + (ch + 1) * m_interleave - m_chunk_size, m_chunk_size);
+      adpcm_rib_decode_frame({reinterpret_cast<const int8_t *>(frame.data()), frame.size()}, decoded,
+                             channel_status.at(i).at(ch));
+    }
   }
 
-  size_t interleave_size_decoded = m_nb_chunks_in_interleave * m_nb_channels * m_nb_chunk_decoded * sizeof(int16_t);
-  size_t nb_interleaves = std::ceil((float)input_size / (float)(interleave_size_decoded)) * m_count_files;
+  CodecBuffer<int8_t> silence(interleave_size);
+  for (size_t round = 0; round < nb_rounds; round++) {
+    for (uint32_t i = 0; i < m_count_files; i++) {
+      auto data = input_files.at(i)->data();
+      if ((round + 1) * interleave_size <= data.size()) {
+        output_file.write(data.data() + round * interleave_size, interleave_size);
+      } else {
+        encode_silence(channel_status.at(i), silence);
+        output_file.write(reinterpret_cast<char *>(silence.data()), interleave_size);
+      }
+    }
+  }
 
-  for (auto &itm : input_files) {
-    itm.second.seekg(sizeof(wav_hdr), std::ios::beg);
+  output_file.close();
+  std::cout << "done!" << std::endl;
+}
+
+void Codec::replace_substream(const std::filesystem::path &rib_file, uint32_t substream,
+                              const std::filesystem::path &wav_file) const {
+  if (substream >= m_count_files) {
+    throw std::runtime_error(std::format("Substream {} is out of range 0..{}", substream, m_count_files - 1));
+  }
+
+  // WAV must have layout of RIB, otherwise interleaves of other substreams would be overwritten
+  MappedFile input_file(wav_file);
+  auto pcm = pcm_data(input_file, wav_file);
+  ByteSource input(pcm);
+  std::fstream rib(rib_file, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+
+  if (!rib.is_open()) {
+    throw std::runtime_error(std::format("Can't open output file for writing {}", rib_file.string()));
   }
 
-  std::vector<std::vector<std::shared_ptr<ADPCMChannelStatus>>> channel_status(
-      m_count_files,
-      std::vector<std::shared_ptr<ADPCMChannelStatus>>(m_nb_channels)
-      );
+  size_t interleave_size = m_nb_channels * m_interleave;
+  size_t rib_size = rib.tellg();
+  if (rib_size % (interleave_size * m_count_files) != 0) {
+    throw std::runtime_error(std::format("Input file {} is not aligned to interleave size", rib_file.string()));
+  }
+
+  std::cout << std::format("Replacing substream {} of {} with {} ... ", substream, rib_file.string(),
+                           wav_file.string());
+
+  size_t nb_rounds = rib_size / (interleave_size * m_count_files);
+  size_t nb_new_rounds = std::max(nb_rounds, interleaves_count(pcm.size()));
+
+  // Longer substream extends file, other substreams are padded with silence as encoder would do
+  if (nb_new_rounds > nb_rounds) {
+    CodecBuffer<int8_t> silence;
 
-  for (int i = 0; i < m_count_files; i++) {
-    for (int ch = 0; ch < m_nb_channels; ch++) {
-      channel_status.at(i).at(ch) = std::make_shared<ADPCMChannelStatus>();
+    for (uint32_t i = 0; i < m_count_files; i++) {
+      if (i == substream) {
+        continue;
+      }
+      std::vector<ADPCMChannelStatus> channel_status(m_nb_channels);
+      if (nb_rounds > 0) {
+        read_final_status(rib, (nb_rounds - 1) * m_count_files + i, channel_status);
+      }
+      for (size_t round = nb_rounds; round < nb_new_rounds; round++) {
+        encode_silence(channel_status, silence);
+        rib.seekp((round * m_count_files + i) * interleave_size);
+        rib.write(reinterpret_cast<char *>(silence.data()), interleave_size);
+      }
     }
   }
 
-  for (int i = 0; i < nb_interleaves; i++) {
-    std::vector<std::shared_ptr<std::vector<int8_t>>> outputs(m_nb_channels);
+  // Only slots of replaced substream are rewritten, shorter substream is padded with silence
+  std::vector<ADPCMChannelStatus> channel_status(m_nb_channels);
+  CodecBuffer<int16_t> buffer;
+  CodecBuffer<int16_t> planar;
+  CodecBuffer<int8_t> output;
+  for (size_t round = 0; round < nb_new_rounds; round++) {
+    size_t size;
+    encode_interleave(read_interleave(input, buffer, size), channel_status, planar, output, substream);
+    rib.seekp((round * m_count_files + substream) * interleave_size);
+    rib.write(reinterpret_cast<char *>(output.data()), interleave_size);
+  }
+
+  if (!rib.good()) {
+    throw std::runtime_error(std::format("Can't write to output file {}", rib_file.string()));
+  }
+
+  rib.close();
+  std::cout << "done!" << std::endl;
+}
+
+std::filesystem::path Codec::substream_path(const std::filesystem::path &file, uint32_t substream) const {
+  std::filesystem::path construct_file = file.parent_path() / std::format("{}_{}", file.stem().string(), substream);
+  construct_file.replace_extension(file.extension());
+  return construct_file;
+}
+
+void Codec::encode_silence(std::vector<ADPCMChannelStatus> &channel_status, CodecBuffer<int8_t> &output) const {
+  CodecBuffer<int16_t> input(m_nb_chunk_decoded, 0);
+  output.resize(m_nb_channels * m_interleave);
 
-    for (int ch = 0; ch < m_nb_channels; ch++) {
-      outputs.at(ch) = std::make_shared<std::vector<int8_t>>();
+  for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+    for (uint32_t j = 0; j < m_nb_chunks_in_interleave; j++) {
+      adpcm_rib_encode_frame(channel_status.at(ch), input,
+                             std::span(output).subspan(ch * m_interleave + j * m_chunk_size, m_chunk_size));
     }
+  }
+}
 
-    for (int k = 0; k < m_nb_chunks_in_interleave; k++) {
-      std::vector<std::shared_ptr<std::vector<int16_t>>> inputs(m_nb_channels);
-      for (int ch = 0; ch < m_nb_channels; ch++) {
-        inputs.at(ch) = std::make_shared<std::vector<int16_t>>();
+uint64_t Codec::decode_buffers_size() const {
+  uint64_t samples_size = (uint64_t)m_nb_chunks_in_interleave * m_nb_chunk_decoded * m_nb_channels * sizeof(int16_t);
+  // Partial interleave, interleaved and planar samples
+  return m_nb_channels * m_interleave + 2 * samples_size;
+}
+
+uint64_t Codec::encode_buffers_size() const {
+  uint64_t samples_size = (uint64_t)m_nb_chunks_in_interleave * m_nb_chunk_decoded * m_nb_channels * sizeof(int16_t);
+  // Partial interleave and stream buffer of each input, planar samples, encoded interleave
+  return 2 * m_count_files * samples_size + samples_size + m_nb_channels * m_interleave;
+}
+
+uint64_t Codec::input_window(uint64_t buffers_size) const {
+  if (m_options.max_memory == 0) {
+    return UINT64_MAX;
+  }
+  if (m_options.max_memory < buffers_size) {
+    throw std::runtime_error(std::format("Memory budget of {} bytes is less than {} bytes needed by codec buffers",
+                                         m_options.max_memory, buffers_size));
+  }
+  return m_options.max_memory - buffers_size;
+}
+
+size_t Codec::interleaves_count(size_t input_size) const {
+  size_t interleave_size_decoded = m_nb_chunks_in_interleave * m_nb_channels * m_nb_chunk_decoded * sizeof(int16_t);
+  return (input_size + interleave_size_decoded - 1) / interleave_size_decoded;
+}
+
+std::span<const char> Codec::pcm_data(const MappedFile &file, const std::filesystem::path &path) const {
+  if (!file.is_open()) {
+    throw std::runtime_error(std::format("Can't open input file for reading {}", path.string()));
+  }
+  return pcm_data(file.data(), path.string());
+}
+
+std::span<const char> Codec::pcm_data(std::span<const char> file, const std::string &name) const {
+  if (m_options.raw_input) {
+    return file;
+  }
+
+  auto info = parse_wav(file);
+  if (!info.has_value() || !info->is_pcm16()) {
+    throw std::runtime_error(std::format("Input file {} is not 16-bit PCM WAV file", name));
+  }
+  if (info->nb_channels != m_nb_channels || info->frequency != m_frequency) {
+    throw std::runtime_error(std::format("Input file {} has different layout ({} channels, {} Hz)", name,
+                                         info->nb_channels, info->frequency));
+  }
+  return file.subspan(info->data_offset, info->data_size);
+}
+
+std::span<const int8_t> Codec::interleave_at(std::span<const char> data, size_t index,
+                                             CodecBuffer<int8_t> &buffer) const {
+  size_t interleave_size = m_nb_channels * m_interleave;
+  if ((index + 1) * interleave_size <= data.size()) {
+    return {reinterpret_cast<const int8_t *>(data.data()) + index * interleave_size, interleave_size};
+  }
+  buffer.assign(interleave_size, 0);
+  if (index * interleave_size < data.size()) {
+    std::copy(data.begin() + index * interleave_size, data.end(), reinterpret_cast<char *>(buffer.data()));
+  }
+  return buffer;
+}
+
+size_t Codec::substream_frames(std::span<const char> data, uint32_t substream) const {
+  if (substream >= m_count_files) {
+    throw std::runtime_error(std::format("Substream {} is out of range 0..{}", substream, m_count_files - 1));
+  }
+  if (m_options.trim_padding) {
+    return count_content_frames(data).at(substream);
+  }
+  return substream_samples(data.size(), substream) / m_nb_chunk_decoded;
+}
+
+std::span<const int16_t> Codec::read_interleave(ByteSource &input, CodecBuffer<int16_t> &buffer, size_t &size) const {
+  size_t nb_samples = m_nb_chunks_in_interleave * m_nb_chunk_decoded * m_nb_channels;
+  auto data = input.read(nb_samples * sizeof(int16_t));
+  size = data.size();
+
+  // Complete interleave is used in place
+  if (size == nb_samples * sizeof(int16_t) && reinterpret_cast<uintptr_t>(data.data()) % alignof(int16_t) == 0) {
+    return {reinterpret_cast<const int16_t *>(data.data()), nb_samples};
+  }
+
+  // Shorter streams are padded with silence
+  buffer.assign(nb_samples, 0);
+  std::memcpy(buffer.data(), data.data(), size);
+  return buffer;
+}
+
+void Codec::encode_interleave(std::span<const int16_t> samples, std::vector<ADPCMChannelStatus> &channel_status,
+                              CodecBuffer<int16_t> &planar, CodecBuffer<int8_t> &output, uint32_t substream) const {
+  // Channels are separated first, so that kernels and interleaving may be measured apart
+  size_t channel_samples = m_nb_chunks_in_interleave * m_nb_chunk_decoded;
+  planar.resize(channel_samples * m_nb_channels);
+  output.resize(m_nb_channels * m_interleave);
+
+  PhaseTimer interleave_timer(m_options.stats, Phase::Interleave);
+  for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+    for (size_t j = 0; j < channel_samples; j++) {
+      planar[ch * channel_samples + j] = convert_pcm(samples[j * m_nb_channels + ch]);
+    }
+  }
+  interleave_timer.stop();
+
+  PhaseTimer kernel_timer(m_options.stats, Phase::Kernel);
+  auto encode_frames = [&](auto &counters) {
+    for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+      for (uint32_t k = 0; k < m_nb_chunks_in_interleave; k++) {
+        adpcm_rib_encode_frame(channel_status.at(ch),
+                               std::span(planar).subspan(ch * channel_samples + k * m_nb_chunk_decoded,
+                                                         m_nb_chunk_decoded),
+                               std::span(output).subspan(ch * m_interleave + k * m_chunk_size, m_chunk_size),
+                               counters);
       }
+    }
+  };
+  with_kernel_counters(substream, encode_frames);
+}
 
-      for (int j = 0; j < m_nb_chunk_decoded; j++) {
-        for (int ch = 0; ch < m_nb_channels; ch++) {
-          int16_t r;
-          input_files.at(i % m_count_files).second.read(reinterpret_cast<char *>(&r), 2);
-          inputs.at(ch)->push_back(UTILS::convert_le(r));
+void Codec::read_final_status(std::istream &rib, size_t interleave,
+                              std::vector<ADPCMChannelStatus> &channel_status) const {
+  CodecBuffer<int8_t> frame(m_chunk_size);
+  CodecBuffer<int16_t> decoded(m_nb_chunk_decoded);
+
+  for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+    rib.seekg((interleave * m_nb_channels + ch + 1) * m_interleave - m_chunk_size);
+    rib.read(reinterpret_cast<char *>(frame.data()), m_chunk_size);
+    adpcm_rib_decode_frame(frame, decoded, channel_status.at(ch));
+  }
+}
+
+uint64_t Codec::hash_interleave(std::span<const int16_t> samples) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  for (auto sample : samples) {
+    for (int i = 0; i < 2; i++) {
+      hash ^= (uint8_t)(sample >> (8 * i));
+      hash *= 0x100000001b3;
+    }
+  }
+  return hash;
+}
+
+uint64_t Codec::hash_interleave(std::span<const int8_t> adpcm) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  for (auto byte : adpcm) {
+    hash ^= (uint8_t)byte;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+std::vector<Codec::InterleaveHashes> Codec::read_manifest(const std::filesystem::path &manifest_file,
+                                                          size_t rib_size) const {
+  std::ifstream input(manifest_file);
+  std::vector<InterleaveHashes> hashes;
+
+  std::string magic;
+  uint32_t version, nb_channels, frequency, count_files;
+  size_t size;
+  input >> magic >> version >> nb_channels >> frequency >> count_files >> size;
+  // Manifest of another layout or another file is useless, version 1 had no hashes of RIB data
+  if (!input || magic != "manhuntribber-manifest" || version != 2 || nb_channels != m_nb_channels ||
+      frequency != m_frequency || count_files != m_count_files || size != rib_size) {
+    return {};
+  }
+
+  InterleaveHashes itm;
+  while (input >> std::hex >> itm.pcm >> itm.rib) {
+    hashes.push_back(itm);
+  }
+  return hashes;
+}
+
+void Codec::write_manifest(const std::filesystem::path &manifest_file, size_t rib_size,
+                           const std::vector<InterleaveHashes> &hashes) const {
+  std::ofstream output(manifest_file);
+
+  output << std::format("manhuntribber-manifest 2\n{} {} {}\n{}\n", m_nb_channels, m_frequency, m_count_files,
+                        rib_size);
+  for (const auto &itm : hashes) {
+    output << std::format("{:016x} {:016x}\n", itm.pcm, itm.rib);
+  }
+}
+
+std::vector<size_t> Codec::count_content_frames(std::span<const char> data) const {
+  std::vector<size_t> content_frames(m_count_files, 0);
+  size_t interleave_size = m_nb_channels * m_interleave;
+  size_t nb_interleaves = (data.size() + interleave_size - 1) / interleave_size;
+
+  // Scan backwards until first non-zero frame of each substream
+  for (uint32_t s = 0; s < m_count_files; s++) {
+    for (size_t i = nb_interleaves; i-- > 0 && content_frames.at(s) == 0;) {
+      if (i % m_count_files != s) {
+        continue;
+      }
+      for (uint32_t j = m_nb_chunks_in_interleave; j-- > 0;) {
+        bool is_silent = true;
+        for (uint32_t ch = 0; ch < m_nb_channels && is_silent; ch++) {
+          size_t offset = i * interleave_size + ch * m_interleave + j * m_chunk_size;
+          if (offset < data.size()) {
+            auto frame = data.subspan(offset, std::min<size_t>(m_chunk_size, data.size() - offset));
+            is_silent = adpcm_rib_is_silent_frame({reinterpret_cast<const int8_t *>(frame.data()), frame.size()});
+          }
+        }
+        if (!is_silent) {
+          content_frames.at(s) = (i / m_count_files) * m_nb_chunks_in_interleave + j + 1;
+          break;
         }
       }
+    }
+  }
+  return content_frames;
+}
 
-      for (int ch = 0; ch < m_nb_channels; ch++) {
-        adpcm_rib_encode_frame(channel_status.at(i % m_count_files).at(ch), inputs.at(ch), outputs.at(ch));
+void Codec::decode_interleave(std::span<const int8_t> input, size_t nb_frames, CodecBuffer<int16_t> &samples,
+                              CodecBuffer<int16_t> &planar, uint32_t substream) const {
+  // Channels are decoded apart first, so that kernels and interleaving may be measured apart
+  size_t channel_samples = m_nb_chunks_in_interleave * m_nb_chunk_decoded;
+  planar.resize(channel_samples * m_nb_channels);
+  ADPCMChannelStatus channel_status{};
+
+  PhaseTimer kernel_timer(m_options.stats, Phase::Kernel);
+  auto decode_frames = [&](auto &counters) {
+    for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+      for (uint32_t k = 0; k < nb_frames; k++) {
+        adpcm_rib_decode_frame(input.subspan(ch * m_interleave + k * m_chunk_size, m_chunk_size),
+                               std::span(planar).subspan(ch * channel_samples + k * m_nb_chunk_decoded,
+                                                         m_nb_chunk_decoded),
+                               channel_status, counters);
       }
     }
-
-    for (int ch = 0; ch < m_nb_channels; ch++) {
-      output_file.write(reinterpret_cast<char *>(outputs.at(ch)->data()), outputs.at(ch)->size());
+  };
+  with_kernel_counters(substream, decode_frames);
+  kernel_timer.stop();
+
+  PhaseTimer interleave_timer(m_options.stats, Phase::Interleave);
+  samples.assign(channel_samples * m_nb_channels, 0);
+  for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+    for (size_t j = 0; j < nb_frames * m_nb_chunk_decoded; j++) {
+      samples[j * m_nb_channels + ch] = convert_pcm(planar[ch * channel_samples + j]);
     }
   }
-
-  output_file.close();
-  std::cout << "done!" << std::endl;
 }
@@ -3,38 +3,198 @@
 
 #pragma once
 
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <span>
+#include <string>
 #include <vector>
 
-#include "byteswap.h"
-
-typedef struct WAV_HEADER {
-  char RIFF[4] = {'R', 'I', 'F', 'F'};               // RIFF Header      Magic header
-  uint32_t ChunkSize = 0;                            // RIFF Chunk Size
-  char WAVE[4] = {'W', 'A', 'V', 'E'};               // WAVE Header
-  char fmt[4] = {'f', 'm', 't', ' '};                // FMT header
-  uint32_t Subchunk1Size = UTILS::convert_le(16);    // Size of the fmt chunk
-  uint16_t AudioFormat = UTILS::convert_le(1);       // Audio format 1=PCM
-  uint16_t NumOfChan = UTILS::convert_le(2);         // Number of channels 1=Mono 2=Stereo
-  uint32_t SamplesPerSec = UTILS::convert_le(44100); // Sampling Frequency in Hz
-  uint32_t bytesPerSec = UTILS::convert_le(176400);  // bytes per second (SamplesPerSec * blockAlign)
-  uint16_t blockAlign = UTILS::convert_le(4);        // 2=16-bit mono, 4=16-bit stereo
-  uint16_t bitsPerSample = UTILS::convert_le(16);    // Number of bits per sample
-  char Subchunk2ID[4] = {'d', 'a', 't', 'a'};        // "data"  string
-  uint32_t Subchunk2Size = 0;                        // Sampled data length
-} wav_hdr;
+#include "adpcm_codec.h"
+#include "file_io.h"
+#include "memory_usage.h"
+#include "stats.h"
+#include "wav.h"
+
+/**
+ * Additional options for Codec
+ */
+struct CodecOptions {
+  /// Don't write trailing padding (zero frames at the end of stream) into decoded file
+  bool trim_padding = false;
+  /// PCM input has no WAV header
+  bool raw_input = false;
+  /// PCM output has no WAV header
+  bool raw_output = false;
+  /// Byte order of PCM samples. WAV files are always little-endian, raw PCM may be native.
+  std::endian pcm_endian = std::endian::little;
+  /// Phase timings of conversions are accumulated here, null disables measurement. Codec must be used by one thread.
+  CodecStats *stats = nullptr;
+  /**
+   * Kernel events (clips, step index saturations, step index and nibble distributions) are accumulated here for each
+   * substream. Counted only when built with MANHUNTRIBBER_KERNEL_COUNTERS.
+   */
+  std::vector<ADPCMCounters> *kernel_counters = nullptr;
+  /**
+   * Memory budget of conversion, bytes (0 is unlimited). Codec buffers must fit into it, the rest bounds resident
+   * part of mapped input file: pages already converted are released once they exceed it.
+   */
+  uint64_t max_memory = 0;
+};
 
 /**
  * Class for code and decode ADPCM streams
  */
 class Codec {
 public:
-  Codec(bool is_mono, uint32_t frequency, uint32_t count_files);
+  Codec(bool is_mono, uint32_t frequency, uint32_t count_files, const CodecOptions &options = {});
   void decode(const std::filesystem::path &rib_file, const std::filesystem::path& wav_file) const;
-  void encode(std::vector<std::filesystem::path> in_files, std::filesystem::path rib_file) const;
+  /**
+   * Encode WAV files into RIB. Input "-" is stdin with WAV header already read by caller (it defines stream layout),
+   * stdin_size is size of its "data" chunk (UINT64_MAX for streaming-style header or raw input, stdin is read to the
+   * end then). Output "-" is stdout. With raw input files have no header.
+   */
+  void encode(std::vector<std::filesystem::path> in_files, std::filesystem::path rib_file,
+              uint64_t stdin_size = UINT64_MAX) const;
+  /**
+   * Encode PCM data of streams positioned after WAV header. Each interleave is written as soon as it's
+   * read, last one is padded with silence.
+   */
+  void encode(const std::vector<std::istream *> &inputs, std::ostream &output) const;
+  /**
+   * Encode WAV files over previously encoded RIB, rewriting only interleaves with changed PCM data. Returns number
+   * of rewritten interleaves.
+   * PCM and RIB hashes are kept in manifest file next to RIB (file.rib.manifest). Interleave is re-encoded when its
+   * RIB data doesn't match manifest (file was rewritten by other means), without manifest every interleave is
+   * encoded and compared against existing one.
+   */
+  size_t encode_incremental(const std::vector<std::filesystem::path> &in_files, std::filesystem::path rib_file) const;
+  /**
+   * Encode PCM data of substreams from memory (byte order is defined by options). Last interleave is padded with
+   * silence.
+   */
+  void encode(const std::vector<std::span<const char>> &inputs, std::ostream &output) const;
+  /// Exact size of decoded substream of RIB data in memory (WAV header unless output is raw, PCM data)
+  [[nodiscard]] uint64_t decoded_size(std::span<const std::byte> rib, uint32_t substream = 0) const;
+  /// Decode substream of RIB data in memory, output is resized to decoded_size()
+  void decode(std::span<const std::byte> rib, std::vector<std::byte> &output, uint32_t substream = 0) const;
+  /// Decode substream of RIB data in memory into buffer of at least decoded_size() bytes, returns bytes written
+  size_t decode(std::span<const std::byte> rib, std::span<std::byte> output, uint32_t substream = 0) const;
+  /// Exact size of RIB encoded from WAV (or raw PCM) files in memory
+  [[nodiscard]] uint64_t encoded_size(const std::vector<std::span<const std::byte>> &inputs) const;
+  /// Encode WAV (or raw PCM) files in memory, output is resized to encoded_size()
+  void encode(const std::vector<std::span<const std::byte>> &inputs, std::vector<std::byte> &output) const;
+  /// Encode WAV (or raw PCM) files in memory into buffer of at least encoded_size() bytes, returns bytes written
+  size_t encode(const std::vector<std::span<const std::byte>> &inputs, std::span<std::byte> output) const;
+  /// Number of decoded samples (per channel) of substream in RIB data of given size, trailing padding included
+  [[nodiscard]] uint64_t substream_samples(uint64_t rib_size, uint32_t substream) const;
+  /**
+   * Decode samples of substream starting from first_sample into interleaved PCM buffer. Returns number of decoded
+   * samples per channel, it's less than buffer fits only at the end of substream.
+   */
+  size_t decode_range(std::span<const char> rib, uint32_t substream, uint64_t first_sample,
+                      std::span<int16_t> output) const;
+  /// Split complex RIB into simple RIBs (one per file) by moving interleaves as is
+  void demux(const std::filesystem::path &rib_file, const std::filesystem::path &out_file) const;
+  /// Join simple RIBs into complex RIB by moving interleaves as is, shorter streams padded with encoded silence
+  void mux(const std::vector<std::filesystem::path> &in_files, const std::filesystem::path &rib_file) const;
+
+  /// Encode WAV file into one substream of complex RIB in place, other substreams stay untouched
+  void replace_substream(const std::filesystem::path &rib_file, uint32_t substream,
+                         const std::filesystem::path &wav_file) const;
+
+  /// Upper bound of bytes held by codec buffers while decoding
+  [[nodiscard]] uint64_t decode_buffers_size() const;
+  /// Upper bound of bytes held by codec buffers while encoding
+  [[nodiscard]] uint64_t encode_buffers_size() const;
+
+  [[nodiscard]] uint32_t nb_channels() const { return m_nb_channels; }
+  [[nodiscard]] uint32_t frequency() const { return m_frequency; }
+  [[nodiscard]] uint32_t count_files() const { return m_count_files; }
+  [[nodiscard]] uint32_t chunk_size() const { return m_chunk_size; }
+  [[nodiscard]] uint32_t interleave_size() const { return m_interleave * m_nb_channels; }
+  /// Number of samples (per channel) decoded from one frame
+  [[nodiscard]] uint32_t frame_samples() const { return m_nb_chunk_decoded; }
 
 private:
+  /// Manifest entry of interleave
+  struct InterleaveHashes {
+    uint64_t pcm = 0;
+    uint64_t rib = 0;
+
+    bool operator==(const InterleaveHashes &) const = default;
+  };
+
+  /// Locate PCM data in mapped input file (whole file for raw input, "data" chunk for WAV)
+  [[nodiscard]] std::span<const char> pcm_data(const MappedFile &file, const std::filesystem::path &path) const;
+  [[nodiscard]] std::span<const char> pcm_data(std::span<const char> file, const std::string &name) const;
+  /// Interleave of RIB data, partial trailing interleave is copied into buffer and padded with zeros
+  std::span<const int8_t> interleave_at(std::span<const char> data, size_t index, CodecBuffer<int8_t> &buffer) const;
+  /**
+   * Bytes of mapped input allowed to stay resident within memory budget, throws if codec buffers of given size don't
+   * fit into it
+   */
+  [[nodiscard]] uint64_t input_window(uint64_t buffers_size) const;
+  /// Number of frames in decoded substream, trailing padding excluded with trim option
+  [[nodiscard]] size_t substream_frames(std::span<const char> data, uint32_t substream) const;
+  /// Encode PCM data of sources
+  void encode(std::vector<ByteSource> &inputs, std::ostream &output) const;
+  /// Convert PCM sample to/from byte order of PCM data
+  [[nodiscard]] int16_t convert_pcm(int16_t sample) const {
+    return m_options.pcm_endian == std::endian::native ? sample : UTILS::byteswap(sample);
+  }
+  /// Count frames of each substream up to trailing padding
+  [[nodiscard]] std::vector<size_t> count_content_frames(std::span<const char> data) const;
+  /**
+   * Decode first nb_frames frames of interleave of substream into PCM data, rest of interleave is silence. Channels
+   * are decoded into planar buffer first. Both buffers are reused, so only first interleave allocates them.
+   */
+  void decode_interleave(std::span<const int8_t> input, size_t nb_frames, CodecBuffer<int16_t> &samples,
+                         CodecBuffer<int16_t> &planar, uint32_t substream) const;
+  /// Number of interleaves needed to encode PCM data of given size
+  [[nodiscard]] size_t interleaves_count(size_t input_size) const;
+  /**
+   * Read one interleave of PCM data, padding it with silence at end of stream. Data is returned in place if possible,
+   * otherwise it's copied into buffer. Size is set to number of bytes actually read.
+   */
+  std::span<const int16_t> read_interleave(ByteSource &input, CodecBuffer<int16_t> &buffer, size_t &size) const;
+  /// Encode one interleave of PCM data of substream, channels are separated into reused planar buffer first
+  void encode_interleave(std::span<const int16_t> samples, std::vector<ADPCMChannelStatus> &channel_status,
+                         CodecBuffer<int16_t> &planar, CodecBuffer<int8_t> &output, uint32_t substream) const;
+  /**
+   * Run kernels with counters of substream if they are compiled in and requested, otherwise with policy counting
+   * nothing
+   */
+  template <typename Kernels> void with_kernel_counters(uint32_t substream, Kernels &kernels) const {
+    ADPCMNoCounters no_counters;
+#ifdef MANHUNTRIBBER_KERNEL_COUNTERS
+    if (m_options.kernel_counters) {
+      if (m_options.kernel_counters->size() < m_count_files) {
+        m_options.kernel_counters->resize(m_count_files);
+      }
+      kernels(m_options.kernel_counters->at(substream));
+      return;
+    }
+#endif
+    (void)substream;
+    kernels(no_counters);
+  }
+  /// Restore encoder state after given interleave of RIB file
+  void read_final_status(std::istream &rib, size_t interleave, std::vector<ADPCMChannelStatus> &channel_status) const;
+  /// Hashes of interleave PCM and ADPCM data for incremental encoding
+  static uint64_t hash_interleave(std::span<const int16_t> samples);
+  static uint64_t hash_interleave(std::span<const int8_t> adpcm);
+  [[nodiscard]] std::vector<InterleaveHashes> read_manifest(const std::filesystem::path &manifest_file,
+                                                            size_t rib_size) const;
+  void write_manifest(const std::filesystem::path &manifest_file, size_t rib_size,
+                      const std::vector<InterleaveHashes> &hashes) const;
+  /// Construct name of file for substream (file_0.wav .. file_5.wav for complex streams)
+  [[nodiscard]] std::filesystem::path substream_path(const std::filesystem::path &file, uint32_t substream) const;
+  /// Encode interleave of silence, continuing from channel statuses
+  void encode_silence(std::vector<ADPCMChannelStatus> &channel_status, CodecBuffer<int8_t> &output) const;
+
+  CodecOptions m_options;
   /// Count of files in RIB. Mostly is 1, but for music files (M variant) is 6.
   uint32_t m_count_files;
   /// Interleave
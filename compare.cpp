@@ -0,0 +1,215 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+#include "compare.h"
+
+namespace {
+/// Bytes of PCM compared with one memcmp, multiple of any block align of 16-bit PCM
+constexpr size_t pcm_block_size = 0x3000;
+
+void check_open(const MappedFile &mapped, const std::filesystem::path &file) {
+  if (!mapped.is_open()) {
+    throw std::runtime_error(std::format("Can't open input file for reading {}", file.string()));
+  }
+}
+
+template <typename T> std::string join(const std::vector<T> &values) {
+  std::string result;
+  for (const auto &itm : values) {
+    result += result.empty() ? std::format("{}", itm) : std::format(", {}", itm);
+  }
+  return result;
+}
+} // namespace
+
+std::vector<uint64_t> RibComparison::interleaves() const {
+  std::vector<uint64_t> result;
+  for (const auto &itm : frames) {
+    // Frames are in file order, so equal interleaves are adjacent
+    if (result.empty() || result.back() != itm.interleave) {
+      result.push_back(itm.interleave);
+    }
+  }
+  return result;
+}
+
+std::vector<uint32_t> RibComparison::substreams() const {
+  std::vector<uint32_t> result;
+  for (const auto &itm : frames) {
+    result.push_back(itm.substream);
+  }
+  std::ranges::sort(result);
+  auto tail = std::ranges::unique(result);
+  result.erase(tail.begin(), tail.end());
+  return result;
+}
+
+void RibComparison::print(std::ostream &output, size_t max_frames) const {
+  if (is_equal()) {
+    output << std::format("Files are equal, {} frames\n", nb_frames);
+    return;
+  }
+  if (size_a != size_b) {
+    output << std::format("Sizes differ: {} and {} bytes, {} common frames compared\n", size_a, size_b, nb_frames);
+  }
+  if (frames.empty()) {
+    output << "Common frames are equal\n";
+    return;
+  }
+  auto interleaves = this->interleaves();
+  output << std::format("{} of {} frames differ in {} interleave(s), substream(s) {}\n", frames.size(), nb_frames,
+                        interleaves.size(), join(substreams()));
+  auto print_frame = [&](const FrameDifference &frame) {
+    output << std::format("interleave {} substream {} channel {} frame {} sample {} offset {:#x}\n", frame.interleave,
+                          frame.substream, frame.channel, frame.frame, frame.first_sample, frame.offset);
+  };
+  output << "First differing frame: ";
+  print_frame(frames.front());
+  for (size_t i = 1; i < std::min(max_frames, frames.size()); i++) {
+    print_frame(frames.at(i));
+  }
+  if (max_frames < frames.size()) {
+    output << std::format("... {} more\n", frames.size() - max_frames);
+  }
+}
+
+void WavComparison::print(std::ostream &output) const {
+  if (is_equal()) {
+    output << std::format("PCM data is equal, {} samples\n", nb_samples_a);
+    return;
+  }
+  if (nb_samples_a != nb_samples_b) {
+    output << std::format("Lengths differ: {} and {} samples\n", nb_samples_a, nb_samples_b);
+  }
+  if (!first_sample.has_value()) {
+    output << "Common samples are equal\n";
+    return;
+  }
+  output << std::format("{} samples differ, first at sample {} channel {}, max difference {}, RMS difference {:.3f}\n",
+                        nb_differences, *first_sample, first_channel, max_difference, rms_difference);
+}
+
+RibComparison compare_rib(std::span<const char> a, std::span<const char> b, const Codec &codec) {
+  RibComparison result;
+  result.size_a = a.size();
+  result.size_b = b.size();
+  size_t size = std::min(a.size(), b.size());
+  uint32_t interleave_size = codec.interleave_size();
+  uint32_t channel_size = interleave_size / codec.nb_channels();
+  uint32_t chunk_size = codec.chunk_size();
+  uint32_t nb_chunks = channel_size / chunk_size;
+
+  for (size_t start = 0; start < size; start += interleave_size) {
+    size_t length = std::min<size_t>(interleave_size, size - start);
+    // Partial interleave at the end of file holds whole channels, last frame of channel may be partial
+    result.nb_frames += codec.nb_channels() * ((std::min<size_t>(length, channel_size) + chunk_size - 1) / chunk_size);
+    if (std::memcmp(a.data() + start, b.data() + start, length) == 0) {
+      continue;
+    }
+    uint64_t interleave = start / interleave_size;
+    for (uint32_t channel = 0; channel < codec.nb_channels(); channel++) {
+      for (uint32_t chunk = 0; chunk < nb_chunks; chunk++) {
+        size_t offset = channel * channel_size + chunk * chunk_size;
+        if (offset >= length) {
+          break;
+        }
+        if (std::memcmp(a.data() + start + offset, b.data() + start + offset,
+                        std::min<size_t>(chunk_size, length - offset)) == 0) {
+          continue;
+        }
+        uint64_t frame = interleave / codec.count_files() * nb_chunks + chunk;
+        result.frames.push_back({.interleave = interleave,
+                                 .substream = (uint32_t)(interleave % codec.count_files()),
+                                 .channel = channel,
+                                 .frame = frame,
+                                 .first_sample = frame * codec.frame_samples(),
+                                 .offset = start + offset});
+      }
+    }
+  }
+  return result;
+}
+
+RibComparison compare_rib(const std::filesystem::path &a, const std::filesystem::path &b, const Codec &codec) {
+  MappedFile file_a(a);
+  MappedFile file_b(b);
+  check_open(file_a, a);
+  check_open(file_b, b);
+  return compare_rib(file_a.data(), file_b.data(), codec);
+}
+
+WavComparison compare_wav(std::span<const char> a, std::span<const char> b) {
+  auto info_a = parse_wav(a);
+  auto info_b = parse_wav(b);
+  // Headers come from files being checked, so they are validated before any arithmetic
+  if (!info_a.has_value() || !info_a->is_pcm16() || info_a->nb_channels == 0 || !info_b.has_value() ||
+      !info_b->is_pcm16() || info_b->nb_channels == 0) {
+    throw std::runtime_error("Compared files must be 16-bit PCM WAV files");
+  }
+  if (info_a->nb_channels != info_b->nb_channels || info_a->frequency != info_b->frequency) {
+    throw std::runtime_error(std::format("Formats of compared files differ ({} channels, {} Hz and {} channels, {} Hz)",
+                                         info_a->nb_channels, info_a->frequency, info_b->nb_channels,
+                                         info_b->frequency));
+  }
+  WavComparison result;
+  result.nb_channels = info_a->nb_channels;
+  uint32_t block_align = info_a->nb_channels * sizeof(int16_t);
+  result.nb_samples_a = info_a->data_size / block_align;
+  result.nb_samples_b = info_b->data_size / block_align;
+
+  const char *data_a = a.data() + info_a->data_offset;
+  const char *data_b = b.data() + info_b->data_offset;
+  uint64_t size = std::min(result.nb_samples_a, result.nb_samples_b) * block_align;
+  double sum_squares = 0;
+  for (uint64_t start = 0; start < size; start += pcm_block_size) {
+    size_t length = std::min<uint64_t>(pcm_block_size, size - start);
+    if (std::memcmp(data_a + start, data_b + start, length) == 0) {
+      continue;
+    }
+    for (size_t offset = start; offset < start + length; offset += sizeof(int16_t)) {
+      int16_t sample_a;
+      int16_t sample_b;
+      std::memcpy(&sample_a, data_a + offset, sizeof(int16_t));
+      std::memcpy(&sample_b, data_b + offset, sizeof(int16_t));
+      int32_t difference = UTILS::convert_le(sample_a) - UTILS::convert_le(sample_b);
+      if (difference == 0) {
+        continue;
+      }
+      if (!result.first_sample.has_value()) {
+        result.first_sample = offset / block_align;
+        result.first_channel = offset % block_align / sizeof(int16_t);
+      }
+      result.nb_differences++;
+      result.max_difference = std::max<uint32_t>(result.max_difference, std::abs(difference));
+      sum_squares += (double)difference * difference;
+    }
+  }
+  if (size > 0) {
+    result.rms_difference = std::sqrt(sum_squares / (size / sizeof(int16_t)));
+  }
+  return result;
+}
+
+WavComparison compare_wav(const std::filesystem::path &a, const std::filesystem::path &b) {
+  MappedFile file_a(a);
+  MappedFile file_b(b);
+  check_open(file_a, a);
+  check_open(file_b, b);
+  return compare_wav(file_a.data(), file_b.data());
+}
+
+bool files_equal(const std::filesystem::path &a, const std::filesystem::path &b) {
+  MappedFile file_a(a);
+  MappedFile file_b(b);
+  if (!file_a.is_open() || !file_b.is_open() || file_a.size() != file_b.size()) {
+    return false;
+  }
+  return file_a.size() == 0 || std::memcmp(file_a.data().data(), file_b.data().data(), file_a.size()) == 0;
+}
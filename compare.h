@@ -0,0 +1,93 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "codec.h"
+
+/**
+ * ADPCM frame that differs between two RIB files
+ */
+struct FrameDifference {
+  /// Index of interleave in file
+  uint64_t interleave = 0;
+  uint32_t substream = 0;
+  uint32_t channel = 0;
+  /// Index of frame in channel of substream
+  uint64_t frame = 0;
+  /// First sample of frame in channel of substream
+  uint64_t first_sample = 0;
+  /// Offset of frame from the start of file
+  uint64_t offset = 0;
+};
+
+/**
+ * Result of frame-level comparison of two RIB files. Only common part is compared frame by frame, extra bytes of
+ * longer file are reported by sizes.
+ */
+struct RibComparison {
+  uint64_t size_a = 0;
+  uint64_t size_b = 0;
+  /// Number of (possibly partial) frames in common part
+  uint64_t nb_frames = 0;
+  /// Differing frames in file order
+  std::vector<FrameDifference> frames;
+
+  [[nodiscard]] bool is_equal() const { return size_a == size_b && frames.empty(); }
+  /// Indexes of interleaves with differing frames
+  [[nodiscard]] std::vector<uint64_t> interleaves() const;
+  /// Substreams with differing frames
+  [[nodiscard]] std::vector<uint32_t> substreams() const;
+  /// Summary and at most max_frames differing frames starting with the first one
+  void print(std::ostream &output, size_t max_frames = SIZE_MAX) const;
+};
+
+/**
+ * Result of comparison of PCM data of two 16-bit WAV files of the same format. Samples are compared up to length of
+ * shorter file.
+ */
+struct WavComparison {
+  uint16_t nb_channels = 0;
+  /// Samples per channel
+  uint64_t nb_samples_a = 0;
+  uint64_t nb_samples_b = 0;
+  /// Number of differing samples, all channels
+  uint64_t nb_differences = 0;
+  /// Index of first differing sample per channel and its channel
+  std::optional<uint64_t> first_sample;
+  uint32_t first_channel = 0;
+  /// Maximum absolute difference of samples
+  uint32_t max_difference = 0;
+  /// Root mean square of differences over common samples of all channels
+  double rms_difference = 0;
+
+  [[nodiscard]] bool is_equal() const { return nb_samples_a == nb_samples_b && nb_differences == 0; }
+  void print(std::ostream &output) const;
+};
+
+/**
+ * Compare RIB files of codec layout. Interleaves are compared whole with memcmp, frames are compared only inside
+ * differing interleaves.
+ */
+[[nodiscard]] RibComparison compare_rib(std::span<const char> a, std::span<const char> b, const Codec &codec);
+[[nodiscard]] RibComparison compare_rib(const std::filesystem::path &a, const std::filesystem::path &b,
+                                        const Codec &codec);
+
+/**
+ * Compare PCM data of 16-bit WAV files, headers (chunk layout, metadata) are ignored. Files that aren't 16-bit PCM,
+ * have no channels, or differ in number of channels or frequency are rejected with exception. Blocks of samples are
+ * compared with memcmp, differences are computed only inside differing blocks.
+ */
+[[nodiscard]] WavComparison compare_wav(std::span<const char> a, std::span<const char> b);
+[[nodiscard]] WavComparison compare_wav(const std::filesystem::path &a, const std::filesystem::path &b);
+
+/**
+ * Byte-exact comparison of mapped files, false if any of them can't be opened
+ */
+[[nodiscard]] bool files_equal(const std::filesystem::path &a, const std::filesystem::path &b);
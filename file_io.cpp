@@ -0,0 +1,149 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include "file_io.h"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path &file) {
+  m_file = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                       nullptr);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    m_file = nullptr;
+    return;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size)) {
+    return;
+  }
+  m_size = size.QuadPart;
+  if (m_size == 0) {
+    // Empty files can't be mapped
+    m_is_open = true;
+    return;
+  }
+  m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (m_mapping == nullptr) {
+    return;
+  }
+  m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  m_is_open = m_data != nullptr;
+}
+
+size_t MappedFile::release(std::span<const char> data) const {
+  // Unlocking pages that aren't locked removes them from working set
+  if (!VirtualUnlock(const_cast<char *>(data.data()), data.size()) && GetLastError() != ERROR_NOT_LOCKED) {
+    return 0;
+  }
+  return data.size();
+}
+
+MappedFile::~MappedFile() {
+  if (m_data) {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping) {
+    CloseHandle(m_mapping);
+  }
+  if (m_file) {
+    CloseHandle(m_file);
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path &file) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) == 0) {
+    m_size = st.st_size;
+    if (m_size == 0) {
+      // Empty files can't be mapped
+      m_is_open = true;
+    } else {
+      void *addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        m_data = static_cast<const char *>(addr);
+        m_is_open = true;
+        // Data is read mostly sequentially
+        madvise(addr, m_size, MADV_SEQUENTIAL);
+      }
+    }
+  }
+  // Mapping stays valid after descriptor closing
+  close(fd);
+}
+
+size_t MappedFile::release(std::span<const char> data) const {
+  static const auto page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+  auto begin = ((uintptr_t)data.data() + page_size - 1) / page_size * page_size;
+  auto end = ((uintptr_t)data.data() + data.size()) / page_size * page_size;
+  // Private mapping is never written, so dropped pages are read from file again
+  if (begin >= end || madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED) != 0) {
+    return 0;
+  }
+  return end - begin;
+}
+
+MappedFile::~MappedFile() {
+  if (m_data) {
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+}
+
+#endif
+
+std::span<const char> ByteSource::read(size_t size) {
+  if (m_stream == nullptr) {
+    auto result = m_data.first(std::min(size, m_data.size()));
+    m_data = m_data.subspan(result.size());
+    return result;
+  }
+  m_buffer.resize(std::min<uint64_t>(size, m_remaining));
+  m_stream->read(m_buffer.data(), m_buffer.size());
+  size_t read = m_stream->gcount();
+  m_remaining -= read;
+  return {m_buffer.data(), read};
+}
+
+size_t ByteSource::release_read(size_t keep) {
+  if (m_file == nullptr || (size_t)(m_data.data() - m_released) <= keep) {
+    return 0;
+  }
+  size_t size = m_file->release({m_released, m_data.data()});
+  m_released = m_data.data();
+  return size;
+}
+
+void prefault(std::span<const char> data) {
+  constexpr size_t page_size = 4096;
+  volatile char sink = 0;
+  for (size_t pos = 0; pos < data.size(); pos += page_size) {
+    sink = data[pos];
+  }
+  (void)sink;
+}
+
+void set_binary_mode(FILE *stream) {
+#ifdef _WIN32
+  _setmode(_fileno(stream), _O_BINARY);
+#else
+  (void)stream;
+#endif
+}
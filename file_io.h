@@ -0,0 +1,96 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <istream>
+#include <span>
+#include <streambuf>
+#include <vector>
+
+#include "memory_usage.h"
+
+/**
+ * Read-only memory mapping of whole file
+ */
+class MappedFile {
+public:
+  explicit MappedFile(const std::filesystem::path &file);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// Is file successfully opened and mapped
+  [[nodiscard]] bool is_open() const { return m_is_open; }
+  [[nodiscard]] std::span<const char> data() const { return {m_data, m_size}; }
+  [[nodiscard]] size_t size() const { return m_size; }
+  /**
+   * Drop resident pages of part of mapping, they are read from file again on next access. Only whole pages inside
+   * data are released, returns their size.
+   */
+  size_t release(std::span<const char> data) const;
+
+private:
+  bool m_is_open = false;
+  const char *m_data = nullptr;
+  size_t m_size = 0;
+#ifdef _WIN32
+  void *m_file = nullptr;
+  void *m_mapping = nullptr;
+#endif
+};
+
+/**
+ * Sequential reader of memory buffer (mapped file) or stream. Memory is read without copying.
+ */
+class ByteSource {
+public:
+  explicit ByteSource(std::span<const char> data) : m_data(data) {}
+  /// Read data of mapped file, pages already read may be released
+  ByteSource(const MappedFile &file, std::span<const char> data)
+      : m_data(data), m_file(&file), m_released(data.data()) {}
+  /// Read at most size bytes from stream
+  explicit ByteSource(std::istream &stream, uint64_t size = UINT64_MAX) : m_stream(&stream), m_remaining(size) {}
+
+  /// View of next size bytes (less at the end of data), valid until next call
+  std::span<const char> read(size_t size);
+  /**
+   * Release pages of mapped file already read once there are more than keep bytes of them, returns size of released
+   * pages. Data of memory and streams isn't released.
+   */
+  size_t release_read(size_t keep);
+
+private:
+  std::span<const char> m_data;
+  const MappedFile *m_file = nullptr;
+  /// End of released part of mapped file
+  const char *m_released = nullptr;
+  std::istream *m_stream = nullptr;
+  uint64_t m_remaining = 0;
+  CodecBuffer<char> m_buffer;
+};
+
+/**
+ * Output stream buffer over fixed memory, stream fails when memory is exhausted
+ */
+class SpanWriter : public std::streambuf {
+public:
+  explicit SpanWriter(std::span<char> data) { setp(data.data(), data.data() + data.size()); }
+
+  /// Number of bytes written
+  [[nodiscard]] size_t size() const { return pptr() - pbase(); }
+};
+
+/**
+ * Touch every page of memory (mapped file), so that it's read from disk now rather than on first access
+ */
+void prefault(std::span<const char> data);
+
+/**
+ * Switch standard stream (stdin/stdout) to binary mode. Does nothing on POSIX systems.
+ */
+void set_binary_mode(FILE *stream);
@@ -1,36 +1,155 @@
 /* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include "CLI11.hpp"
-#include "byteswap.h"
 #include "codec.h"
+#include "compare.h"
+#include "file_io.h"
 #include "manhuntribber_version.h"
+#include "perf_counters.h"
+#include "stats.h"
+#include "trace.h"
+#include "wav.h"
 
-void decode(const std::filesystem::path &in_file, const std::filesystem::path& out_file, bool is_mono, uint32_t frequency, uint32_t nb_streams) {
-  Codec codec(is_mono, frequency, nb_streams);
+void decode(const std::filesystem::path &in_file, const std::filesystem::path& out_file, bool is_mono, uint32_t frequency, uint32_t nb_streams, const CodecOptions &options) {
+  // Trailing padding is found by scanning whole stream, length of stdin isn't known in advance
+  if (in_file == "-" && options.trim_padding) {
+    throw std::runtime_error("Trimming of padding (--trim) isn't supported for stdin input (-)");
+  }
+  Codec codec(is_mono, frequency, nb_streams, options);
   codec.decode(in_file, out_file);
 }
 
-void encode(const std::vector<std::filesystem::path>& in_files, const std::filesystem::path& out_file) {
-  std::ifstream input_file(in_files.front(), std::ios::binary);
+WavInfo read_wav_info(const std::filesystem::path &in_file) {
+  std::optional<WavInfo> info;
+  if (in_file == "-") {
+    // Stdin can't be reopened, so codec continues right after header
+    set_binary_mode(stdin);
+    info = parse_wav(std::cin);
+  } else {
+    MappedFile input_file(in_file);
+    if (!input_file.is_open()) {
+      throw std::runtime_error(std::format("Can't open input file for reading {}", in_file.string()));
+    }
+    info = parse_wav(input_file.data());
+  }
+
+  if (!info.has_value() || !info->is_pcm16()) {
+    throw std::runtime_error(std::format("Input file {} is not 16-bit PCM WAV file", in_file.string()));
+  }
+  return *info;
+}
 
-  if (!input_file.is_open()) {
-    std::cout << std::format("Can't open input file for reading {}", in_files.front().string()) << std::endl;
-    exit(1);
+void encode(const std::vector<std::filesystem::path>& in_files, const std::filesystem::path& out_file, bool is_incremental, const CodecOptions &options, uint32_t nb_channels, uint32_t frequency) {
+  // Header of stdin input is parsed only for the first input, so stdin must be the only one
+  if (std::ranges::find(in_files, "-") != in_files.end() && (in_files.size() > 1 || is_incremental)) {
+    throw std::runtime_error("Stdin input (-) is supported only as the single input of simple stream");
   }
 
-  wav_hdr wave_header;
-  input_file.read(reinterpret_cast<char *>(&wave_header), sizeof(wav_hdr));
-  input_file.close();
-  Codec codec(UTILS::convert_le(wave_header.NumOfChan) == 1, UTILS::convert_le(wave_header.SamplesPerSec), in_files.size());
-  codec.encode(in_files, out_file);
+  // Raw PCM has no header, layout is defined by user
+  uint64_t stdin_size = UINT64_MAX;
+  if (!options.raw_input) {
+    WavInfo info = read_wav_info(in_files.front());
+    nb_channels = info.nb_channels;
+    frequency = info.frequency;
+    stdin_size = info.data_size;
+  }
+
+  Codec codec(nb_channels == 1, frequency, in_files.size(), options);
+  if (is_incremental) {
+    codec.encode_incremental(in_files, out_file);
+  } else {
+    codec.encode(in_files, out_file, stdin_size);
+  }
+}
+
+/// Attach hardware counters of calling thread to stats, conversion goes on without them if they are unavailable
+void attach_perf_counters(CodecStats &stats, std::unique_ptr<PerfCounters> &perf) {
+  perf = std::make_unique<PerfCounters>();
+  if (!perf->is_available()) {
+    std::clog << std::format("Hardware performance counters are unavailable ({})", perf->error()) << std::endl;
+    return;
+  }
+  if (!perf->error().empty()) {
+    std::clog << std::format("Some hardware performance counters are unavailable ({})", perf->error()) << std::endl;
+  }
+  stats.perf = perf.get();
+}
+
+/// Report of phase timings, table goes to stderr as stdout may carry converted data
+void report_stats(const CodecStats &stats, bool is_text, const std::filesystem::path &json_file) {
+  if (is_text) {
+    stats.print(std::clog);
+  }
+  if (!json_file.empty()) {
+    std::ofstream output(json_file);
+    if (!output.is_open()) {
+      throw std::runtime_error(std::format("Can't open output file for writing {}", json_file.string()));
+    }
+    stats.print_json(output);
+  }
+}
+
+/// Report of kernel counters of each substream
+void report_kernel_counters(const std::vector<ADPCMCounters> &counters) {
+  for (size_t i = 0; i < counters.size(); i++) {
+    std::clog << std::format("Kernel counters of substream {}: ", i);
+    counters.at(i).print(std::clog);
+  }
+}
+
+void replace_substream(const std::filesystem::path &rib_file, uint32_t substream, const std::filesystem::path &in_file,
+                       bool is_mono, uint32_t frequency) {
+  // Layout is the one of RIB, codec rejects WAV that doesn't match it
+  Codec codec(is_mono, frequency, 6);
+  codec.replace_substream(rib_file, substream, in_file);
+}
+
+void demux(const std::filesystem::path &in_file, const std::filesystem::path &out_file, bool is_mono,
+           uint32_t frequency) {
+  Codec codec(is_mono, frequency, 6);
+  codec.demux(in_file, out_file);
+}
+
+void mux(const std::vector<std::filesystem::path> &in_files, const std::filesystem::path &out_file, bool is_mono,
+         uint32_t frequency) {
+  Codec codec(is_mono, frequency, 6);
+  codec.mux(in_files, out_file);
+}
+
+/// RIB files have no header, so anything that isn't WAV file is treated as RIB
+bool is_wav_file(const std::filesystem::path &file) {
+  MappedFile mapped(file);
+  return mapped.is_open() && parse_wav(mapped.data()).has_value();
+}
+
+/// Compare two RIB or two WAV files and print report, WAV files are recognized by header
+bool compare(const std::filesystem::path &a, const std::filesystem::path &b, bool is_mono, uint32_t frequency,
+             uint32_t nb_streams, size_t max_frames) {
+  bool is_wav = is_wav_file(a);
+  if (is_wav != is_wav_file(b)) {
+    throw std::runtime_error(std::format("Can't compare {} with {}: one of them is WAV file and the other is not",
+                                         a.string(), b.string()));
+  }
+  if (is_wav) {
+    auto result = compare_wav(a, b);
+    result.print(std::cout);
+    return result.is_equal();
+  }
+  Codec codec(is_mono, frequency, nb_streams);
+  auto result = compare_rib(a, b, codec);
+  result.print(std::cout, max_frames);
+  return result.is_equal();
 }
 
 int main(int argc, char *argv[]) {
@@ -40,32 +159,206 @@ int main(int argc, char *argv[]) {
   std::filesystem::path out_file;
   bool is_complex = false;
   bool is_mono = false;
+  bool is_incremental = false;
+  CodecOptions options;
+  bool is_native_endian = false;
+  uint32_t nb_channels = 2;
   uint32_t frequency = 44100;
+  uint32_t complex_frequency = 22050;
+  uint32_t substream = 0;
+  std::filesystem::path wav_file;
+  CodecStats stats;
+  bool is_stats = false;
+  std::filesystem::path stats_json;
+  bool is_perf_counters = false;
+  std::unique_ptr<PerfCounters> perf;
+  std::filesystem::path trace_file;
+  // Flag is available only in builds with kernel counters
+  bool is_kernel_counters = false;
+  std::vector<ADPCMCounters> kernel_counters;
+  size_t max_frames = 20;
+  bool is_equal = true;
 
   CLI::App app{"ManhuntRIBber - encode/decode RIB files from Rockstar's Manhunt PC game"};
   app.set_version_flag("-v", MANHUNTRIBBER_VERSION);
   argv = app.ensure_utf8(argv);
-  std::cout << std::format("ManhuntRIBber {} https://github.com/winterheart/ManhuntRIBber\n"
+  // Banner goes to stderr, so stdout may carry decoded data
+  std::clog << std::format("ManhuntRIBber {} https://github.com/winterheart/ManhuntRIBber\n"
                            "(c) 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com>\n",
                            app.version())
             << std::endl;
 
+  // Recording starts as soon as option is parsed, before any subcommand is run
+  app.add_option_function<std::filesystem::path>(
+         "--trace",
+         [&](const std::filesystem::path &file) {
+           trace_file = file;
+           Tracer::enable();
+           Tracer::set_thread_name("main");
+         },
+         "Record spans of conversion into JSON file in Chrome trace event format")
+      ->trigger_on_parse();
+
   auto encode_cmd =
-      app.add_subcommand("encode", "Encode WAV file to RIB")->callback([&]() { encode(in_files, out_file); });
-  encode_cmd->add_option("input", in_files, "Input WAV file(s)")->required()->check(CLI::ExistingFile)->expected(1, 6);
-  encode_cmd->add_option("-o,--output", out_file, "Output RIB file");
+      app.add_subcommand("encode", "Encode WAV file to RIB")->callback([&]() {
+        if (is_native_endian) {
+          options.pcm_endian = std::endian::native;
+        }
+        if (is_perf_counters) {
+          is_stats = true;
+          attach_perf_counters(stats, perf);
+        }
+        if (is_stats || !stats_json.empty()) {
+          options.stats = &stats;
+        }
+        if (is_kernel_counters) {
+          options.kernel_counters = &kernel_counters;
+        }
+        encode(in_files, out_file, is_incremental, options, nb_channels, frequency);
+        report_stats(stats, is_stats, stats_json);
+        report_kernel_counters(kernel_counters);
+      });
+  encode_cmd->add_option("input", in_files, "Input WAV file(s) (- for stdin)")
+      ->required()
+      ->check(CLI::ExistingFile | CLI::IsMember({"-"}))
+      ->expected(1, 6);
+  encode_cmd->add_option("-o,--output", out_file, "Output RIB file (- for stdout)");
+  encode_cmd->add_flag("-i,--incremental", is_incremental, "Rewrite only changed parts of existing output RIB file")
+      ->default_val(is_incremental);
+  auto raw_in_opt = encode_cmd->add_flag("--raw-in", options.raw_input, "Input is raw 16-bit PCM without WAV header")
+                        ->default_val(options.raw_input);
+  encode_cmd->add_option("--channels", nb_channels, "Number of channels of raw input")
+      ->default_val(nb_channels)
+      ->check(CLI::Range(1, 2));
+  encode_cmd->add_option("--rate", frequency, "Frequency of raw input")
+      ->default_val(frequency)
+      ->check(CLI::IsMember({22050, 44100}));
+  // WAV data is always little-endian
+  encode_cmd->add_flag("--native-endian", is_native_endian, "Raw input is in native byte order instead of little-endian")
+      ->default_val(is_native_endian)
+      ->needs(raw_in_opt);
+  encode_cmd->add_flag("--stats", is_stats, "Print time and throughput of conversion phases")->default_val(is_stats);
+  encode_cmd->add_option("--stats-json", stats_json, "Write time and throughput of conversion phases as JSON");
+  encode_cmd->add_flag("--perf-counters", is_perf_counters, "Count hardware events of conversion phases (implies --stats)")
+      ->default_val(is_perf_counters);
+  encode_cmd->add_option("--max-memory", options.max_memory,
+                         "Memory budget of conversion (e.g. 64MB): bounds codec buffers and resident input")
+      ->transform(CLI::AsSizeValue(false));
+#ifdef MANHUNTRIBBER_KERNEL_COUNTERS
+  encode_cmd->add_flag("--kernel-counters", is_kernel_counters, "Count clips, step index saturations and nibbles")
+      ->default_val(is_kernel_counters);
+#endif
 
   auto decode_cmd =
       app.add_subcommand("decode", "Decode RIB file to WAV")->callback([&]() {
-        decode(in_file, out_file, is_mono, frequency, is_complex ? 6 : 1);
+        if (is_native_endian) {
+          options.pcm_endian = std::endian::native;
+        }
+        if (is_perf_counters) {
+          is_stats = true;
+          attach_perf_counters(stats, perf);
+        }
+        if (is_stats || !stats_json.empty()) {
+          options.stats = &stats;
+        }
+        if (is_kernel_counters) {
+          options.kernel_counters = &kernel_counters;
+        }
+        decode(in_file, out_file, is_mono, frequency, is_complex ? 6 : 1, options);
+        report_stats(stats, is_stats, stats_json);
+        report_kernel_counters(kernel_counters);
       });
   decode_cmd->add_flag("-c", is_complex, "Threats input file as Complex stream")->default_val(is_complex);
   decode_cmd->add_option("-f", frequency, "Frequency of the stream")->default_val(frequency);
   decode_cmd->add_flag("-m", is_mono, "Threats input file as Mono stream")->default_val(is_mono);
-  decode_cmd->add_option("input", in_file, "Input WAV file")->required()->check(CLI::ExistingFile);
-  decode_cmd->add_option("-o,--output", out_file, "Output RIB file");
+  decode_cmd->add_flag("-t,--trim", options.trim_padding, "Don't write trailing padding of stream (not for stdin input)")
+      ->default_val(options.trim_padding);
+  auto raw_out_opt = decode_cmd->add_flag("--raw-out", options.raw_output, "Output raw 16-bit PCM without WAV header")
+                         ->default_val(options.raw_output);
+  decode_cmd->add_flag("--native-endian", is_native_endian, "Raw output is in native byte order instead of little-endian")
+      ->default_val(is_native_endian)
+      ->needs(raw_out_opt);
+  decode_cmd->add_option("input", in_file, "Input RIB file (- for stdin)")
+      ->required()
+      ->check(CLI::ExistingFile | CLI::IsMember({"-"}));
+  decode_cmd->add_option("-o,--output", out_file, "Output WAV file (- for stdout)");
+  decode_cmd->add_flag("--stats", is_stats, "Print time and throughput of conversion phases")->default_val(is_stats);
+  decode_cmd->add_option("--stats-json", stats_json, "Write time and throughput of conversion phases as JSON");
+  decode_cmd->add_flag("--perf-counters", is_perf_counters, "Count hardware events of conversion phases (implies --stats)")
+      ->default_val(is_perf_counters);
+  decode_cmd->add_option("--max-memory", options.max_memory,
+                         "Memory budget of conversion (e.g. 64MB): bounds codec buffers and resident input")
+      ->transform(CLI::AsSizeValue(false));
+#ifdef MANHUNTRIBBER_KERNEL_COUNTERS
+  decode_cmd->add_flag("--kernel-counters", is_kernel_counters, "Count clips, step index saturations and nibbles")
+      ->default_val(is_kernel_counters);
+#endif
+
+  auto demux_cmd = app.add_subcommand("demux", "Split complex RIB file to simple RIB files without transcoding")
+                       ->callback([&]() { demux(in_file, out_file, is_mono, complex_frequency); });
+  demux_cmd->add_flag("-m", is_mono, "Threats input file as Mono stream")->default_val(is_mono);
+  demux_cmd->add_option("input", in_file, "Input complex RIB file")->required()->check(CLI::ExistingFile);
+  demux_cmd->add_option("-o,--output", out_file, "Output RIB file");
 
-  CLI11_PARSE(app, argc, argv);
+  auto mux_cmd = app.add_subcommand("mux", "Join simple RIB files to complex RIB file without transcoding")
+                     ->callback([&]() { mux(in_files, out_file, is_mono, complex_frequency); });
+  mux_cmd->add_option("-f", complex_frequency, "Frequency of the streams")->default_val(complex_frequency);
+  mux_cmd->add_flag("-m", is_mono, "Threats input files as Mono streams")->default_val(is_mono);
+  mux_cmd->add_option("input", in_files, "Input RIB files")->required()->check(CLI::ExistingFile)->expected(6);
+  mux_cmd->add_option("-o,--output", out_file, "Output complex RIB file")->required();
 
-  return 0;
+  auto replace_cmd = app.add_subcommand("replace-substream", "Replace one substream of complex RIB file in place")
+                         ->callback([&]() {
+                           replace_substream(in_file, substream, wav_file, is_mono, complex_frequency);
+                         });
+  replace_cmd->add_option("-f", complex_frequency, "Frequency of the streams")
+      ->default_val(complex_frequency)
+      ->check(CLI::IsMember({22050, 44100}));
+  replace_cmd->add_flag("-m", is_mono, "Threats input file as Mono stream")->default_val(is_mono);
+  replace_cmd->add_option("input", in_file, "Complex RIB file to modify")->required()->check(CLI::ExistingFile);
+  replace_cmd->add_option("substream", substream, "Substream number")->required()->check(CLI::Range(0, 5));
+  replace_cmd->add_option("wav", wav_file, "Input WAV file")->required()->check(CLI::ExistingFile);
+
+  auto compare_cmd =
+      app.add_subcommand("compare", "Compare two RIB files frame by frame or PCM data of two WAV files")
+          ->callback([&]() { is_equal = compare(in_files.at(0), in_files.at(1), is_mono, frequency, is_complex ? 6 : 1,
+                                                max_frames); });
+  compare_cmd->add_flag("-c", is_complex, "Threats input files as Complex streams")->default_val(is_complex);
+  compare_cmd->add_option("-f", frequency, "Frequency of the streams")
+      ->default_val(frequency)
+      ->check(CLI::IsMember({22050, 44100}));
+  compare_cmd->add_flag("-m", is_mono, "Threats input files as Mono streams")->default_val(is_mono);
+  compare_cmd->add_option("--max-frames", max_frames, "Number of differing RIB frames to list")
+      ->default_val(max_frames);
+  compare_cmd->add_option("input", in_files, "Input RIB or WAV files")
+      ->required()
+      ->check(CLI::ExistingFile)
+      ->expected(2);
+
+  // Exit status of compare tells if files differ (1) or comparison failed (2), as with cmp
+  auto error_status = [&]() { return compare_cmd->parsed() ? 2 : 1; };
+  int result = 0;
+  try {
+    app.parse(argc, argv);
+    result = is_equal ? 0 : 1;
+  } catch (const CLI::ParseError &e) {
+    result = app.exit(e);
+    if (result != 0) {
+      result = error_status();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    result = error_status();
+  }
+
+  // Spans of failed conversion are written too
+  if (!trace_file.empty()) {
+    try {
+      Tracer::write(trace_file);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      result = error_status();
+    }
+  }
+  return result;
 }
@@ -0,0 +1,221 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <memory>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+
+#include "codec.h"
+#include "file_io.h"
+#include "manhuntribber.h"
+#include "manhuntribber_version.h"
+#include "stream_decoder.h"
+
+struct rib_file {
+  std::unique_ptr<MappedFile> file;
+  std::span<const char> data;
+  Codec codec;
+};
+
+struct rib_stream {
+  RibStreamDecoder decoder;
+};
+
+namespace {
+/**
+ * Unbuffered stream buffer passing everything to sink callback
+ */
+class SinkBuf : public std::streambuf {
+public:
+  SinkBuf(rib_write_fn sink, void *user_data) : m_sink(sink), m_user_data(user_data) {}
+
+  [[nodiscard]] bool is_failed() const { return m_is_failed; }
+
+protected:
+  std::streamsize xsputn(const char *data, std::streamsize size) override {
+    if (m_is_failed || m_sink(m_user_data, data, size) != 0) {
+      m_is_failed = true;
+      return 0;
+    }
+    return size;
+  }
+
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    char value = traits_type::to_char_type(c);
+    return xsputn(&value, 1) == 1 ? c : traits_type::eof();
+  }
+
+private:
+  rib_write_fn m_sink;
+  void *m_user_data;
+  bool m_is_failed = false;
+};
+
+bool is_valid_layout(uint32_t nb_channels, uint32_t frequency, uint32_t nb_substreams) {
+  return (nb_channels == 1 || nb_channels == 2) && (frequency == 22050 || frequency == 44100) &&
+         (nb_substreams == 1 || nb_substreams == RIB_MAX_SUBSTREAMS);
+}
+
+CodecOptions native_options() {
+  CodecOptions options;
+  options.pcm_endian = std::endian::native;
+  return options;
+}
+
+/// Run function converting exceptions into status, no exception may cross C boundary
+template <typename F> rib_status guarded(F &&function) {
+  try {
+    return function();
+  } catch (const std::bad_alloc &) {
+    return RIB_ERROR_OUT_OF_MEMORY;
+  } catch (...) {
+    return RIB_ERROR_INTERNAL;
+  }
+}
+} // namespace
+
+const char *rib_version(void) { return MANHUNTRIBBER_VERSION; }
+
+const char *rib_status_string(rib_status status) {
+  switch (status) {
+  case RIB_OK:
+    return "Success";
+  case RIB_ERROR_INVALID_ARGUMENT:
+    return "Invalid argument";
+  case RIB_ERROR_IO:
+    return "Can't read file";
+  case RIB_ERROR_OUT_OF_RANGE:
+    return "Substream is out of range";
+  case RIB_ERROR_OUT_OF_MEMORY:
+    return "Out of memory";
+  case RIB_ERROR_SINK:
+    return "Sink failed to write data";
+  case RIB_ERROR_INTERNAL:
+    return "Internal error";
+  }
+  return "Unknown error";
+}
+
+rib_status rib_open_file(const char *path, uint32_t nb_channels, uint32_t frequency, uint32_t nb_substreams,
+                         rib_file **file) {
+  if (path == nullptr || file == nullptr || !is_valid_layout(nb_channels, frequency, nb_substreams)) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  return guarded([&]() {
+    auto mapped_file = std::make_unique<MappedFile>(std::filesystem::path(reinterpret_cast<const char8_t *>(path)));
+    if (!mapped_file->is_open()) {
+      return RIB_ERROR_IO;
+    }
+    auto data = mapped_file->data();
+    *file = new rib_file{std::move(mapped_file), data,
+                         Codec(nb_channels == 1, frequency, nb_substreams, native_options())};
+    return RIB_OK;
+  });
+}
+
+rib_status rib_open_memory(const void *data, size_t size, uint32_t nb_channels, uint32_t frequency,
+                           uint32_t nb_substreams, rib_file **file) {
+  if ((data == nullptr && size > 0) || file == nullptr || !is_valid_layout(nb_channels, frequency, nb_substreams)) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  return guarded([&]() {
+    *file = new rib_file{nullptr, {static_cast<const char *>(data), size},
+                         Codec(nb_channels == 1, frequency, nb_substreams, native_options())};
+    return RIB_OK;
+  });
+}
+
+void rib_close(rib_file *file) { delete file; }
+
+rib_status rib_get_layout(const rib_file *file, rib_layout *layout) {
+  if (file == nullptr || layout == nullptr) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  const Codec &codec = file->codec;
+  *layout = rib_layout{};
+  layout->nb_channels = codec.nb_channels();
+  layout->frequency = codec.frequency();
+  layout->nb_substreams = codec.count_files();
+  layout->chunk_size = codec.chunk_size();
+  layout->interleave_size = codec.interleave_size();
+  for (uint32_t i = 0; i < codec.count_files(); i++) {
+    layout->nb_samples[i] = codec.substream_samples(file->data.size(), i);
+  }
+  return RIB_OK;
+}
+
+rib_status rib_decode(const rib_file *file, uint32_t substream, uint64_t first_sample, int16_t *samples,
+                      size_t nb_samples, size_t *nb_decoded) {
+  if (file == nullptr || (samples == nullptr && nb_samples > 0) || nb_decoded == nullptr) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  if (substream >= file->codec.count_files()) {
+    return RIB_ERROR_OUT_OF_RANGE;
+  }
+  return guarded([&]() {
+    *nb_decoded = file->codec.decode_range(file->data, substream, first_sample,
+                                           {samples, nb_samples * file->codec.nb_channels()});
+    return RIB_OK;
+  });
+}
+
+rib_status rib_stream_create(const rib_file *file, uint32_t substream, rib_stream **stream) {
+  if (file == nullptr || stream == nullptr) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  if (substream >= file->codec.count_files()) {
+    return RIB_ERROR_OUT_OF_RANGE;
+  }
+  return guarded([&]() {
+    *stream = new rib_stream{RibStreamDecoder(file->data, file->codec, substream)};
+    return RIB_OK;
+  });
+}
+
+void rib_stream_destroy(rib_stream *stream) { delete stream; }
+
+rib_status rib_stream_read(rib_stream *stream, int16_t *samples, size_t nb_samples, size_t *nb_read) {
+  if (stream == nullptr || (samples == nullptr && nb_samples > 0) || nb_read == nullptr) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  uint32_t nb_channels = stream->decoder.nb_channels();
+  *nb_read = stream->decoder.read({samples, nb_samples * nb_channels}) / nb_channels;
+  return RIB_OK;
+}
+
+rib_status rib_stream_seek(rib_stream *stream, uint64_t sample) {
+  if (stream == nullptr) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  stream->decoder.seek(sample);
+  return RIB_OK;
+}
+
+rib_status rib_encode(uint32_t nb_channels, uint32_t frequency, uint32_t nb_substreams, const int16_t *const *samples,
+                      const size_t *nb_samples, rib_write_fn sink, void *user_data) {
+  if (samples == nullptr || nb_samples == nullptr || sink == nullptr ||
+      !is_valid_layout(nb_channels, frequency, nb_substreams)) {
+    return RIB_ERROR_INVALID_ARGUMENT;
+  }
+  for (uint32_t i = 0; i < nb_substreams; i++) {
+    if (samples[i] == nullptr && nb_samples[i] > 0) {
+      return RIB_ERROR_INVALID_ARGUMENT;
+    }
+  }
+  return guarded([&]() {
+    std::vector<std::span<const char>> inputs;
+    for (uint32_t i = 0; i < nb_substreams; i++) {
+      inputs.emplace_back(reinterpret_cast<const char *>(samples[i]), nb_samples[i] * nb_channels * sizeof(int16_t));
+    }
+    SinkBuf buffer(sink, user_data);
+    std::ostream output(&buffer);
+    Codec codec(nb_channels == 1, frequency, nb_substreams, native_options());
+    codec.encode(inputs, output);
+    return buffer.is_failed() ? RIB_ERROR_SINK : RIB_OK;
+  });
+}
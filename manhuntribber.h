@@ -0,0 +1,127 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * C API of libmanhuntribber. Functions never throw or terminate process, errors are reported with rib_status codes.
+ * PCM samples are 16-bit in native byte order, channels are interleaved.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(MANHUNTRIBBER_SHARED)
+#ifdef MANHUNTRIBBER_BUILDING
+#define MANHUNTRIBBER_API __declspec(dllexport)
+#else
+#define MANHUNTRIBBER_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define MANHUNTRIBBER_API __attribute__((visibility("default")))
+#else
+#define MANHUNTRIBBER_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximum number of substreams (complex streams have 6 of them)
+#define RIB_MAX_SUBSTREAMS 6
+
+typedef enum rib_status {
+  RIB_OK = 0,
+  RIB_ERROR_INVALID_ARGUMENT = -1,
+  RIB_ERROR_IO = -2,
+  RIB_ERROR_OUT_OF_RANGE = -3,
+  RIB_ERROR_OUT_OF_MEMORY = -4,
+  RIB_ERROR_SINK = -5,
+  RIB_ERROR_INTERNAL = -6,
+} rib_status;
+
+/// Opened RIB file
+typedef struct rib_file rib_file;
+
+/// Layout of opened RIB file
+typedef struct rib_layout {
+  uint32_t nb_channels;
+  uint32_t frequency;
+  uint32_t nb_substreams;
+  /// Size of encoded frame in bytes
+  uint32_t chunk_size;
+  /// Size of interleave block (all channels) in bytes
+  uint32_t interleave_size;
+  /// Number of samples per channel of each substream, trailing padding included
+  uint64_t nb_samples[RIB_MAX_SUBSTREAMS];
+} rib_layout;
+
+/**
+ * Sink for encoded data. Returns 0 on success, any other value aborts encoding with RIB_ERROR_SINK.
+ */
+typedef int (*rib_write_fn)(void *user_data, const void *data, size_t size);
+
+/// Version of library, e.g. "0.6.0"
+MANHUNTRIBBER_API const char *rib_version(void);
+
+/// Human-readable description of status
+MANHUNTRIBBER_API const char *rib_status_string(rib_status status);
+
+/**
+ * Open RIB file. RIB has no header, so layout is defined by caller: 1 or 2 channels, 22050 or 44100 Hz, 1 or 6
+ * substreams.
+ */
+MANHUNTRIBBER_API rib_status rib_open_file(const char *path, uint32_t nb_channels, uint32_t frequency,
+                                           uint32_t nb_substreams, rib_file **file);
+
+/**
+ * Open RIB data in memory. Data isn't copied and must outlive the handle.
+ */
+MANHUNTRIBBER_API rib_status rib_open_memory(const void *data, size_t size, uint32_t nb_channels, uint32_t frequency,
+                                             uint32_t nb_substreams, rib_file **file);
+
+/// Close handle, NULL is ignored
+MANHUNTRIBBER_API void rib_close(rib_file *file);
+
+MANHUNTRIBBER_API rib_status rib_get_layout(const rib_file *file, rib_layout *layout);
+
+/**
+ * Decode nb_samples samples (per channel) of substream starting from first_sample into buffer of
+ * nb_samples * nb_channels values. Number of decoded samples is stored in nb_decoded, it's less than requested only
+ * at the end of substream.
+ */
+MANHUNTRIBBER_API rib_status rib_decode(const rib_file *file, uint32_t substream, uint64_t first_sample,
+                                        int16_t *samples, size_t nb_samples, size_t *nb_decoded);
+
+/// Sequential decoder of one substream for real-time playback
+typedef struct rib_stream rib_stream;
+
+/**
+ * Create sequential decoder of substream. File must outlive the stream. Reading and seeking never allocate, so they
+ * are safe to call from audio callback.
+ */
+MANHUNTRIBBER_API rib_status rib_stream_create(const rib_file *file, uint32_t substream, rib_stream **stream);
+
+/// Destroy stream, NULL is ignored
+MANHUNTRIBBER_API void rib_stream_destroy(rib_stream *stream);
+
+/**
+ * Fill buffer with nb_samples samples (per channel) from current position. Past the end of substream buffer is filled
+ * with silence. Number of samples that came from substream is stored in nb_read.
+ */
+MANHUNTRIBBER_API rib_status rib_stream_read(rib_stream *stream, int16_t *samples, size_t nb_samples, size_t *nb_read);
+
+/// Set position of stream in samples per channel
+MANHUNTRIBBER_API rib_status rib_stream_seek(rib_stream *stream, uint64_t sample);
+
+/**
+ * Encode PCM buffers of nb_substreams substreams into RIB data passed to sink. Each buffer holds nb_samples[i] samples
+ * per channel, shorter substreams are padded with silence.
+ */
+MANHUNTRIBBER_API rib_status rib_encode(uint32_t nb_channels, uint32_t frequency, uint32_t nb_substreams,
+                                        const int16_t *const *samples, const size_t *nb_samples, rib_write_fn sink,
+                                        void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <fstream>
+#include <sstream>
+#include <string>
+#endif
+
+#include "memory_usage.h"
+
+ProcessMemory process_memory() {
+  ProcessMemory memory;
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    memory.rss = counters.WorkingSetSize;
+    memory.peak_rss = counters.PeakWorkingSetSize;
+  }
+#elif defined(__linux__)
+  // Sizes are in kB
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    std::istringstream fields(line);
+    std::string name;
+    uint64_t size = 0;
+    fields >> name >> size;
+    if (name == "VmRSS:") {
+      memory.rss = size * 1024;
+    } else if (name == "VmHWM:") {
+      memory.peak_rss = size * 1024;
+    }
+  }
+#else
+  rusage ru{};
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#ifdef __APPLE__
+    memory.peak_rss = ru.ru_maxrss;
+#else
+    memory.peak_rss = (uint64_t)ru.ru_maxrss * 1024;
+#endif
+  }
+#endif
+  return memory;
+}
+
+BufferUsage &thread_buffer_usage() {
+  thread_local BufferUsage usage;
+  return usage;
+}
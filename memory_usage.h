@@ -0,0 +1,65 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Resident memory of process, bytes. Values that can't be queried on platform are zero.
+ */
+struct ProcessMemory {
+  /// Resident set size
+  uint64_t rss = 0;
+  /// Peak resident set size since process start
+  uint64_t peak_rss = 0;
+};
+
+[[nodiscard]] ProcessMemory process_memory();
+
+/**
+ * Codec buffers allocated by one thread
+ */
+struct BufferUsage {
+  /// Bytes allocated in total
+  uint64_t allocated = 0;
+  /// Bytes held now. Buffer freed by another thread makes it negative.
+  int64_t current = 0;
+  /// Maximum of held bytes since last reset
+  int64_t peak = 0;
+};
+
+/// Usage of codec buffers by calling thread
+[[nodiscard]] BufferUsage &thread_buffer_usage();
+
+/**
+ * Allocator of codec buffers, it accounts allocations of calling thread in thread_buffer_usage()
+ */
+template <typename T> class CountingAllocator {
+public:
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    auto &usage = thread_buffer_usage();
+    usage.allocated += n * sizeof(T);
+    usage.current += (int64_t)(n * sizeof(T));
+    usage.peak = std::max(usage.peak, usage.current);
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *ptr, size_t n) {
+    thread_buffer_usage().current -= (int64_t)(n * sizeof(T));
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template <typename U> bool operator==(const CountingAllocator<U> &) const { return true; }
+};
+
+/// Buffer of codec with accounted memory
+template <typename T> using CodecBuffer = std::vector<T, CountingAllocator<T>>;
@@ -0,0 +1,161 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include <format>
+
+#include "perf_counters.h"
+
+const char *perf_event_name(PerfEvent event) {
+  constexpr const char *names[] = {"cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses"};
+  return names[static_cast<size_t>(event)];
+}
+
+PerfCounts &PerfCounts::operator+=(const PerfCounts &other) {
+  for (size_t i = 0; i < nb_perf_events; i++) {
+    values[i] += other.values[i];
+  }
+  mask |= other.mask;
+  return *this;
+}
+
+PerfCounts PerfCounts::operator-(const PerfCounts &other) const {
+  PerfCounts result;
+  result.mask = mask & other.mask;
+  for (size_t i = 0; i < nb_perf_events; i++) {
+    // Scaled multiplexed counts may go slightly backwards
+    result.values[i] = values[i] > other.values[i] ? values[i] - other.values[i] : 0;
+  }
+  return result;
+}
+
+std::string PerfCounts::summary() const {
+  std::string result;
+  for (size_t i = 0; i < nb_perf_events; i++) {
+    auto event = static_cast<PerfEvent>(i);
+    if (!has(event)) {
+      continue;
+    }
+    result += std::format("{}{} {:.2f}M", result.empty() ? "" : ", ", perf_event_name(event), values[i] / 1e6);
+    if (event == PerfEvent::Instructions && has(PerfEvent::Cycles) && (*this)[PerfEvent::Cycles] > 0) {
+      result += std::format(" (IPC {:.2f})", (double)values[i] / (double)(*this)[PerfEvent::Cycles]);
+    }
+    if (event == PerfEvent::BranchMisses && has(PerfEvent::Instructions) && (*this)[PerfEvent::Instructions] > 0) {
+      result += std::format(" ({:.2f}/ki)", 1000.0 * values[i] / (double)(*this)[PerfEvent::Instructions]);
+    }
+  }
+  return result.empty() ? "no counters" : result;
+}
+
+#ifdef __linux__
+
+namespace {
+int open_event(PerfEvent event, int group_fd, bool is_user_only) {
+  constexpr uint64_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  switch (event) {
+  case PerfEvent::Cycles:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PerfEvent::Instructions:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PerfEvent::BranchMisses:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  case PerfEvent::L1dMisses:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1D | cache_read_miss;
+    break;
+  case PerfEvent::LlcMisses:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_LL | cache_read_miss;
+    break;
+  }
+  // Group is started at once after all members are opened
+  attr.disabled = group_fd == -1;
+  attr.exclude_kernel = is_user_only;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // Calling thread on any CPU
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+} // namespace
+
+PerfCounters::PerfCounters() {
+  // Kernel part of I/O is counted where allowed, restricted systems count user space only
+  bool is_user_only = false;
+  for (size_t i = 0; i < nb_perf_events; i++) {
+    auto event = static_cast<PerfEvent>(i);
+    int fd = open_event(event, m_group_fd, is_user_only);
+    if (fd < 0 && m_group_fd == -1 && !is_user_only && (errno == EACCES || errno == EPERM)) {
+      is_user_only = true;
+      fd = open_event(event, m_group_fd, is_user_only);
+    }
+    if (fd < 0) {
+      m_error += std::format("{}{}: {}", m_error.empty() ? "" : ", ", perf_event_name(event), std::strerror(errno));
+      continue;
+    }
+    if (m_group_fd == -1) {
+      m_group_fd = fd;
+    }
+    m_fds.push_back(fd);
+    m_events.push_back(event);
+  }
+  if (m_group_fd != -1) {
+    ioctl(m_group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (auto fd : m_fds) {
+    close(fd);
+  }
+}
+
+PerfCounts PerfCounters::read() const {
+  PerfCounts counts;
+  if (m_group_fd == -1) {
+    return counts;
+  }
+  // nr, time_enabled, time_running, values of members
+  std::array<uint64_t, 3 + nb_perf_events> data{};
+  if (::read(m_group_fd, data.data(), sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t)) || data[0] != m_events.size()) {
+    return counts;
+  }
+  uint64_t time_enabled = data[1];
+  uint64_t time_running = data[2];
+  for (size_t i = 0; i < m_events.size(); i++) {
+    uint64_t value = data[3 + i];
+    if (time_running > 0 && time_running < time_enabled) {
+      value = (uint64_t)((double)value * (double)time_enabled / (double)time_running);
+    }
+    counts.values[static_cast<size_t>(m_events[i])] = value;
+    counts.mask |= 1U << static_cast<size_t>(m_events[i]);
+  }
+  return counts;
+}
+
+#else
+
+PerfCounters::PerfCounters() : m_error("hardware performance counters are supported only on Linux") {}
+
+PerfCounters::~PerfCounters() = default;
+
+PerfCounts PerfCounters::read() const { return {}; }
+
+#endif
@@ -0,0 +1,72 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Hardware events counted by PerfCounters
+ */
+enum class PerfEvent : uint8_t {
+  Cycles,
+  Instructions,
+  BranchMisses,
+  /// Level 1 data cache read misses
+  L1dMisses,
+  /// Last level cache read misses
+  LlcMisses,
+};
+
+constexpr size_t nb_perf_events = 5;
+
+[[nodiscard]] const char *perf_event_name(PerfEvent event);
+
+/**
+ * Counts of hardware events, only events in mask are valid
+ */
+struct PerfCounts {
+  std::array<uint64_t, nb_perf_events> values{};
+  /// Bit (1 << event) is set for counted events
+  uint32_t mask = 0;
+
+  [[nodiscard]] bool has(PerfEvent event) const { return mask & (1U << static_cast<size_t>(event)); }
+  [[nodiscard]] uint64_t operator[](PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+  PerfCounts &operator+=(const PerfCounts &other);
+  /// Counts between two readings of the same counters
+  PerfCounts operator-(const PerfCounts &other) const;
+  /// One line summary, e.g. "cycles 12.3M, instructions 30.1M (IPC 2.45), branch-misses 0.1M (3.3/ki), ..."
+  [[nodiscard]] std::string summary() const;
+};
+
+/**
+ * Hardware performance counters of calling thread (perf_event_open on Linux). Events that can't be counted (no PMU in
+ * virtual machine, restricted perf_event_paranoid, other platforms) are left out, so counters may be unavailable
+ * altogether.
+ */
+class PerfCounters {
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  /// At least one event is counted
+  [[nodiscard]] bool is_available() const { return !m_events.empty(); }
+  /// Why counters or some of events are unavailable, empty if all of them are counted
+  [[nodiscard]] const std::string &error() const { return m_error; }
+  /// Current counts since construction, scaled if events were multiplexed
+  [[nodiscard]] PerfCounts read() const;
+
+private:
+  /// Group leader, its members are read at once
+  int m_group_fd = -1;
+  std::vector<int> m_fds;
+  /// Events in order of group members
+  std::vector<PerfEvent> m_events;
+  std::string m_error;
+};
@@ -0,0 +1,117 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <algorithm>
+#include <format>
+#include <numeric>
+
+#include "stats.h"
+
+namespace {
+constexpr double megabyte = 1024 * 1024;
+
+/// Rate per second of count processed in ns nanoseconds
+double rate(uint64_t count, uint64_t ns) { return ns == 0 ? 0 : (double)count * 1e9 / (double)ns; }
+} // namespace
+
+const char *phase_name(Phase phase) {
+  constexpr const char *names[] = {"open", "header", "read", "kernel", "interleave", "write", "finalize"};
+  return names[static_cast<size_t>(phase)];
+}
+
+CodecStats &CodecStats::operator+=(const CodecStats &other) {
+  for (size_t i = 0; i < nb_phases; i++) {
+    phase_ns[i] += other.phase_ns[i];
+  }
+  input_bytes += other.input_bytes;
+  output_bytes += other.output_bytes;
+  samples += other.samples;
+  nb_files += other.nb_files;
+  buffer_allocated_bytes += other.buffer_allocated_bytes;
+  buffer_peak_bytes = std::max(buffer_peak_bytes, other.buffer_peak_bytes);
+  released_bytes += other.released_bytes;
+  peak_rss = std::max(peak_rss, other.peak_rss);
+  for (size_t i = 0; i < nb_phases; i++) {
+    phase_counts[i] += other.phase_counts[i];
+  }
+  return *this;
+}
+
+uint64_t CodecStats::total_ns() const { return std::accumulate(phase_ns.begin(), phase_ns.end(), uint64_t{0}); }
+
+PerfCounts CodecStats::total_counts() const {
+  PerfCounts total;
+  for (const auto &counts : phase_counts) {
+    total += counts;
+  }
+  return total;
+}
+
+void CodecStats::print(std::ostream &output) const {
+  uint64_t total = total_ns();
+  output << std::format("{} file(s), input {:.2f} MB, output {:.2f} MB, {} samples\n", nb_files,
+                        input_bytes / megabyte, output_bytes / megabyte, samples);
+  output << std::format("peak RSS {:.2f} MB, codec buffers {:.2f} MB peak, {:.2f} MB allocated", peak_rss / megabyte,
+                        buffer_peak_bytes / megabyte, buffer_allocated_bytes / megabyte);
+  output << (released_bytes == 0 ? "\n" : std::format(", {:.2f} MB of input released\n", released_bytes / megabyte));
+  output << std::format("{:<11} {:>10} {:>6} {:>10} {:>12}\n", "phase", "time ms", "%", "MB/s", "Msamples/s");
+  auto print_row = [&](const char *name, uint64_t ns) {
+    output << std::format("{:<11} {:>10.3f} {:>6.1f} {:>10.1f} {:>12.2f}\n", name, ns / 1e6,
+                          total == 0 ? 0 : 100.0 * ns / total, rate(input_bytes, ns) / megabyte,
+                          rate(samples, ns) / 1e6);
+  };
+  for (size_t i = 0; i < nb_phases; i++) {
+    print_row(phase_name(static_cast<Phase>(i)), phase_ns[i]);
+  }
+  print_row("total", total);
+
+  auto total_counts = this->total_counts();
+  if (total_counts.mask == 0) {
+    return;
+  }
+  output << std::format("{:<11}", "phase");
+  for (size_t j = 0; j < nb_perf_events; j++) {
+    output << std::format(" {:>15}", perf_event_name(static_cast<PerfEvent>(j)));
+  }
+  output << std::format(" {:>6} {:>15}\n", "IPC", "br-misses/ki");
+  auto print_counts = [&](const char *name, const PerfCounts &counts) {
+    output << std::format("{:<11}", name);
+    for (size_t j = 0; j < nb_perf_events; j++) {
+      auto event = static_cast<PerfEvent>(j);
+      output << (counts.has(event) ? std::format(" {:>15}", counts[event]) : std::format(" {:>15}", "-"));
+    }
+    uint64_t cycles = counts[PerfEvent::Cycles];
+    uint64_t instructions = counts[PerfEvent::Instructions];
+    output << std::format(" {:>6.2f} {:>15.2f}\n", cycles == 0 ? 0 : (double)instructions / cycles,
+                          instructions == 0 ? 0 : 1000.0 * counts[PerfEvent::BranchMisses] / instructions);
+  };
+  for (size_t i = 0; i < nb_phases; i++) {
+    print_counts(phase_name(static_cast<Phase>(i)), phase_counts[i]);
+  }
+  print_counts("total", total_counts);
+}
+
+void CodecStats::print_json(std::ostream &output) const {
+  uint64_t total = total_ns();
+  output << std::format("{{\"files\": {}, \"input_bytes\": {}, \"output_bytes\": {}, \"samples\": {}, "
+                        "\"peak_rss\": {}, \"buffer_peak_bytes\": {}, \"buffer_allocated_bytes\": {}, "
+                        "\"released_bytes\": {}, \"total_ns\": {}, \"phases\": {{",
+                        nb_files, input_bytes, output_bytes, samples, peak_rss, buffer_peak_bytes,
+                        buffer_allocated_bytes, released_bytes, total);
+  for (size_t i = 0; i < nb_phases; i++) {
+    output << std::format("{}\"{}\": {{\"ns\": {}, \"percent\": {:.3f}, \"bytes_per_second\": {:.0f}, "
+                          "\"samples_per_second\": {:.0f}",
+                          i == 0 ? "" : ", ", phase_name(static_cast<Phase>(i)), phase_ns[i],
+                          total == 0 ? 0 : 100.0 * phase_ns[i] / total, rate(input_bytes, phase_ns[i]),
+                          rate(samples, phase_ns[i]));
+    // Only counted events are present
+    for (size_t j = 0; j < nb_perf_events; j++) {
+      auto event = static_cast<PerfEvent>(j);
+      if (phase_counts[i].has(event)) {
+        output << std::format(", \"{}\": {}", perf_event_name(event), phase_counts[i][event]);
+      }
+    }
+    output << "}";
+  }
+  output << "}}\n";
+}
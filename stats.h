@@ -0,0 +1,153 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "memory_usage.h"
+#include "perf_counters.h"
+#include "trace.h"
+
+/**
+ * Phases of conversion
+ */
+enum class Phase : uint8_t {
+  /// Opening and mapping of files
+  Open,
+  /// WAV header parsing, padding scan and header writing
+  Header,
+  /// Reading of input data (pages of mapped input are touched, so disk reads are accounted here)
+  Read,
+  /// ADPCM frame encoding/decoding
+  Kernel,
+  /// Interleaving/deinterleaving of channels and PCM byte swapping
+  Interleave,
+  /// Writing of output data
+  Write,
+  /// Header fixup, closing and flushing of outputs
+  Finalize,
+};
+
+constexpr size_t nb_phases = 7;
+
+[[nodiscard]] const char *phase_name(Phase phase);
+
+/**
+ * Time spent in phases of conversions along with amount of processed data. Not thread-safe, use one object per thread
+ * and merge them.
+ */
+struct CodecStats {
+  /// Time of each phase, nanoseconds
+  std::array<uint64_t, nb_phases> phase_ns{};
+  /// Bytes of RIB or PCM data read
+  uint64_t input_bytes = 0;
+  /// Bytes of RIB or PCM data written
+  uint64_t output_bytes = 0;
+  /// PCM samples per channel, all substreams summed
+  uint64_t samples = 0;
+  /// Number of conversions
+  uint32_t nb_files = 0;
+  /// Hardware counters of measuring thread read at phase boundaries, null disables them. Not merged.
+  const PerfCounters *perf = nullptr;
+  /// Hardware event counts of each phase
+  std::array<PerfCounts, nb_phases> phase_counts{};
+  /// Bytes allocated for codec buffers
+  uint64_t buffer_allocated_bytes = 0;
+  /// Peak bytes held by codec buffers of conversion, largest conversion when merged
+  uint64_t buffer_peak_bytes = 0;
+  /// Bytes of mapped input released early to stay within memory budget
+  uint64_t released_bytes = 0;
+  /// Peak resident set size of process after conversion, largest one when merged
+  uint64_t peak_rss = 0;
+
+  CodecStats &operator+=(const CodecStats &other);
+  [[nodiscard]] uint64_t total_ns() const;
+  [[nodiscard]] PerfCounts total_counts() const;
+  /// Memory usage, table of phases with time, share of total, MB/s and samples/s of input, and hardware counters
+  void print(std::ostream &output) const;
+  void print_json(std::ostream &output) const;
+};
+
+/**
+ * Scoped time measurement of phase, it's also recorded as trace span when tracing is enabled. Does nothing when stats
+ * is null and tracing is disabled.
+ */
+class PhaseTimer {
+public:
+  PhaseTimer(CodecStats *stats, Phase phase) : m_stats(stats), m_phase(phase), m_is_traced(Tracer::is_enabled()) {
+    if (m_stats || m_is_traced) {
+      if (m_stats && m_stats->perf) {
+        m_counts = m_stats->perf->read();
+      }
+      m_start = std::chrono::steady_clock::now();
+    }
+  }
+  ~PhaseTimer() { stop(); }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  /// End measurement before end of scope
+  void stop() {
+    if (!m_stats && !m_is_traced) {
+      return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (m_stats) {
+      m_stats->phase_ns[static_cast<size_t>(m_phase)] +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count();
+      if (m_stats->perf) {
+        m_stats->phase_counts[static_cast<size_t>(m_phase)] += m_stats->perf->read() - m_counts;
+      }
+    }
+    if (m_is_traced) {
+      Tracer::record(phase_name(m_phase), -1, m_start, end);
+    }
+    m_stats = nullptr;
+    m_is_traced = false;
+  }
+
+private:
+  CodecStats *m_stats;
+  Phase m_phase;
+  bool m_is_traced;
+  std::chrono::steady_clock::time_point m_start;
+  PerfCounts m_counts;
+};
+
+/**
+ * Scoped measurement of codec buffers allocated by calling thread during conversion and peak RSS of process after
+ * it. Does nothing when stats is null.
+ */
+class MemoryMeter {
+public:
+  explicit MemoryMeter(CodecStats *stats) : m_stats(stats) {
+    if (m_stats) {
+      auto &usage = thread_buffer_usage();
+      m_allocated = usage.allocated;
+      m_current = usage.current;
+      usage.peak = usage.current;
+    }
+  }
+  ~MemoryMeter() {
+    if (m_stats) {
+      const auto &usage = thread_buffer_usage();
+      m_stats->buffer_allocated_bytes += usage.allocated - m_allocated;
+      m_stats->buffer_peak_bytes = std::max<uint64_t>(m_stats->buffer_peak_bytes, usage.peak - m_current);
+      m_stats->peak_rss = std::max(m_stats->peak_rss, process_memory().peak_rss);
+    }
+  }
+
+  MemoryMeter(const MemoryMeter &) = delete;
+  MemoryMeter &operator=(const MemoryMeter &) = delete;
+
+private:
+  CodecStats *m_stats;
+  uint64_t m_allocated = 0;
+  int64_t m_current = 0;
+};
@@ -0,0 +1,110 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+#include "adpcm_codec.h"
+#include "stream_decoder.h"
+#include "trace.h"
+
+RibStreamDecoder::RibStreamDecoder(std::span<const char> data, const Codec &codec, uint32_t substream)
+    : m_data(data), m_substream(substream), m_count_files(codec.count_files()), m_nb_channels(codec.nb_channels()),
+      m_chunk_size(codec.chunk_size()), m_interleave(codec.interleave_size() / codec.nb_channels()),
+      m_nb_chunks_in_interleave(m_interleave / m_chunk_size), m_nb_chunk_decoded(codec.frame_samples()),
+      m_frame(static_cast<size_t>(m_nb_chunk_decoded) * m_nb_channels), m_channel_frame(m_nb_chunk_decoded) {
+  if (substream >= m_count_files) {
+    throw std::runtime_error(std::format("Substream {} is out of range 0..{}", substream, m_count_files - 1));
+  }
+  m_length = codec.substream_samples(data.size(), substream);
+}
+
+size_t RibStreamDecoder::read(std::span<int16_t> output) {
+  size_t nb_samples = std::min<uint64_t>(output.size() / m_nb_channels, m_length - m_position);
+  size_t done = 0;
+  while (done < nb_samples) {
+    uint64_t frame_index = m_position / m_nb_chunk_decoded;
+    size_t offset = m_position % m_nb_chunk_decoded;
+    size_t count = std::min<size_t>(m_nb_chunk_decoded - offset, nb_samples - done);
+    if (frame_index != m_frame_index) {
+      decode_frame(frame_index);
+    }
+    std::copy_n(m_frame.begin() + offset * m_nb_channels, count * m_nb_channels,
+                output.begin() + done * m_nb_channels);
+    done += count;
+    m_position += count;
+  }
+  std::fill(output.begin() + done * m_nb_channels, output.end(), 0);
+  return done * m_nb_channels;
+}
+
+void RibStreamDecoder::seek(uint64_t sample) { m_position = std::min(sample, m_length); }
+
+void RibStreamDecoder::decode_frame(uint64_t frame_index) {
+  uint64_t interleave = frame_index / m_nb_chunks_in_interleave * m_count_files + m_substream;
+  uint64_t frame_pos =
+      interleave * m_interleave * m_nb_channels + frame_index % m_nb_chunks_in_interleave * m_chunk_size;
+
+  for (uint32_t ch = 0; ch < m_nb_channels; ch++) {
+    uint64_t pos = frame_pos + ch * m_interleave;
+    std::span<const int8_t> input;
+    if (pos + m_chunk_size <= m_data.size()) {
+      input = {reinterpret_cast<const int8_t *>(m_data.data()) + pos, m_chunk_size};
+    } else {
+      // Partial trailing interleave is decoded as if it was padded with zeros
+      std::fill(m_padded.begin(), m_padded.end(), 0);
+      if (pos < m_data.size()) {
+        std::copy(m_data.begin() + pos, m_data.end(), reinterpret_cast<char *>(m_padded.data()));
+      }
+      input = std::span<const int8_t>(m_padded).first(m_chunk_size);
+    }
+    ADPCMChannelStatus channel_status{};
+    adpcm_rib_decode_frame(input, m_channel_frame, channel_status);
+    for (uint32_t j = 0; j < m_nb_chunk_decoded; j++) {
+      m_frame[j * m_nb_channels + ch] = m_channel_frame[j];
+    }
+  }
+  m_frame_index = frame_index;
+}
+
+RibBackgroundDecoder::RibBackgroundDecoder(std::span<const char> data, const Codec &codec, uint32_t substream)
+    : m_decoder(data, codec, substream), m_size(m_decoder.length() * m_decoder.nb_channels()),
+      m_frame_size(codec.frame_samples() * m_decoder.nb_channels()), m_samples(new int16_t[m_size]) {
+  size_t nb_values = m_decoder.read({m_samples.get(), std::min(m_frame_size, m_size)});
+  m_available.store(nb_values, std::memory_order_release);
+  if (nb_values < m_size) {
+    m_thread = std::thread(&RibBackgroundDecoder::run, this);
+  }
+}
+
+RibBackgroundDecoder::~RibBackgroundDecoder() {
+  m_is_stopped = true;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+std::span<const int16_t> RibBackgroundDecoder::available() const {
+  return {m_samples.get(), m_available.load(std::memory_order_acquire)};
+}
+
+void RibBackgroundDecoder::wait() {
+  TraceSpan span("wait");
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void RibBackgroundDecoder::run() {
+  // Frames are published one by one, each read decodes exactly one frame
+  size_t position = m_available.load(std::memory_order_relaxed);
+  if (Tracer::is_enabled()) {
+    Tracer::set_thread_name("background decoder");
+  }
+  while (position < m_size && !m_is_stopped) {
+    TraceSpan span("decode frame", (int64_t)(position / m_frame_size));
+    position += m_decoder.read({m_samples.get() + position, std::min(m_frame_size, m_size - position)});
+    m_available.store(position, std::memory_order_release);
+  }
+}
@@ -0,0 +1,101 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "codec.h"
+
+/**
+ * Pull-based decoder of one substream of RIB data for real-time playback. Frames are decoded lazily on read, every
+ * frame is independent, so seek is cheap. Nothing is allocated after construction.
+ */
+class RibStreamDecoder {
+public:
+  /// Decoder of substream of RIB data (memory or mapped file) with layout of codec, data must outlive decoder
+  RibStreamDecoder(std::span<const char> data, const Codec &codec, uint32_t substream = 0);
+
+  /**
+   * Fill output with interleaved samples from current position. Output is always filled completely, past the end of
+   * substream with silence. Returns number of values that came from substream.
+   */
+  size_t read(std::span<int16_t> output);
+  /// Set position (in samples per channel), position past the end is clamped to length
+  void seek(uint64_t sample);
+
+  /// Current position in samples per channel
+  [[nodiscard]] uint64_t position() const { return m_position; }
+  /// Length of substream in samples per channel, trailing padding included
+  [[nodiscard]] uint64_t length() const { return m_length; }
+  [[nodiscard]] uint32_t nb_channels() const { return m_nb_channels; }
+
+private:
+  /// Decode frame of substream into interleaved frame buffer
+  void decode_frame(uint64_t frame_index);
+
+  std::span<const char> m_data;
+  uint32_t m_substream;
+  uint32_t m_count_files;
+  uint32_t m_nb_channels;
+  uint32_t m_chunk_size;
+  /// Interleave size of one channel
+  uint32_t m_interleave;
+  uint32_t m_nb_chunks_in_interleave;
+  uint32_t m_nb_chunk_decoded;
+  uint64_t m_length = 0;
+  uint64_t m_position = 0;
+  /// Index of frame in m_frame, UINT64_MAX if none
+  uint64_t m_frame_index = UINT64_MAX;
+  /// Decoded frame, interleaved
+  std::vector<int16_t> m_frame;
+  /// Decoded frame of one channel
+  std::vector<int16_t> m_channel_frame;
+  /// Partial trailing frame padded with zeros
+  std::array<int8_t, 0x400> m_padded{};
+};
+
+/**
+ * Decoder of whole substream optimized for time to first sample: only the first frame of each channel is decoded in
+ * constructor, the rest of substream is decoded by background thread. Samples are published in order, so playback may
+ * start at once.
+ */
+class RibBackgroundDecoder {
+public:
+  /// Start decoding substream of RIB data with layout of codec, data must outlive decoder
+  RibBackgroundDecoder(std::span<const char> data, const Codec &codec, uint32_t substream = 0);
+  /// Stop background decoding
+  ~RibBackgroundDecoder();
+
+  RibBackgroundDecoder(const RibBackgroundDecoder &) = delete;
+  RibBackgroundDecoder &operator=(const RibBackgroundDecoder &) = delete;
+
+  /// Already decoded interleaved samples from the start of substream, grows until is_done()
+  [[nodiscard]] std::span<const int16_t> available() const;
+  [[nodiscard]] bool is_done() const { return m_available.load(std::memory_order_acquire) == m_size; }
+  /// Wait until whole substream is decoded
+  void wait();
+  /// Length of substream in samples per channel
+  [[nodiscard]] uint64_t length() const { return m_decoder.length(); }
+
+private:
+  void run();
+
+  RibStreamDecoder m_decoder;
+  /// Number of values in substream
+  size_t m_size;
+  /// Number of values in decoded frame
+  size_t m_frame_size;
+  /// Decoded samples, left uninitialized so that nothing but the first frame is touched before first sample
+  std::unique_ptr<int16_t[]> m_samples;
+  /// Number of decoded values
+  std::atomic<size_t> m_available = 0;
+  std::atomic<bool> m_is_stopped = false;
+  std::thread m_thread;
+};
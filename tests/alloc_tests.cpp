@@ -0,0 +1,202 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * Allocation tests. Global operator new/delete are replaced with counting ones, so tests can check that decoding and
+ * encoding allocate only on setup: conversion of longer stream must allocate exactly as much as conversion of shorter
+ * one, and pull-based decoder must not allocate after construction at all.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "codec.h"
+#include "file_io.h"
+#include "manhuntribber.h"
+#include "stream_decoder.h"
+
+namespace {
+std::atomic<size_t> nb_allocations = 0;
+
+void *allocate(size_t size, size_t alignment = 0) {
+  nb_allocations.fetch_add(1, std::memory_order_relaxed);
+  size = size == 0 ? 1 : size;
+  // Size of aligned allocation must be multiple of alignment
+  void *ptr = alignment == 0 ? std::malloc(size)
+                             : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+} // namespace
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return allocate(size, (size_t)alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return allocate(size, (size_t)alignment); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+namespace {
+/**
+ * Number of allocations made by all threads since construction
+ */
+class AllocationCounter {
+public:
+  AllocationCounter() : m_start(nb_allocations.load()) {}
+
+  [[nodiscard]] size_t count() const { return nb_allocations.load() - m_start; }
+
+private:
+  size_t m_start;
+};
+
+struct Layout {
+  const char *name;
+  bool is_mono;
+  uint32_t frequency;
+  uint32_t count_files;
+};
+
+void PrintTo(const Layout &layout, std::ostream *output) { *output << layout.name; }
+
+/// Rounds of interleaves of shorter and longer streams
+constexpr size_t short_rounds = 2;
+constexpr size_t long_rounds = 7;
+
+/// Raw PCM of substreams, last interleave is partial
+std::vector<std::vector<int16_t>> generate_pcm(const Codec &codec, size_t nb_rounds) {
+  size_t interleave_samples = codec.interleave_size() / codec.chunk_size() * codec.frame_samples();
+  std::vector<std::vector<int16_t>> pcm(codec.count_files());
+  for (uint32_t i = 0; i < codec.count_files(); i++) {
+    pcm.at(i).resize(nb_rounds * interleave_samples - 1000 * codec.nb_channels());
+    for (size_t j = 0; j < pcm.at(i).size(); j++) {
+      pcm.at(i).at(j) = (int16_t)(12000 * std::sin((double)j * 0.01 * (i + 1)));
+    }
+  }
+  return pcm;
+}
+
+std::vector<std::span<const std::byte>> as_inputs(const std::vector<std::vector<int16_t>> &pcm) {
+  std::vector<std::span<const std::byte>> inputs;
+  for (const auto &itm : pcm) {
+    inputs.push_back(std::as_bytes(std::span(itm)));
+  }
+  return inputs;
+}
+
+Codec make_codec(const Layout &layout) {
+  return {layout.is_mono, layout.frequency, layout.count_files,
+          {.raw_input = true, .raw_output = true, .pcm_endian = std::endian::native}};
+}
+} // namespace
+
+class Allocations : public ::testing::TestWithParam<Layout> {};
+
+TEST_P(Allocations, decode) {
+  auto codec = make_codec(GetParam());
+  auto count_decode = [&](size_t nb_rounds) {
+    std::vector<std::byte> rib;
+    codec.encode(as_inputs(generate_pcm(codec, nb_rounds)), rib);
+    std::vector<std::byte> output(codec.decoded_size(rib));
+    AllocationCounter counter;
+    for (uint32_t i = 0; i < codec.count_files(); i++) {
+      codec.decode(rib, std::span(output), i);
+    }
+    return counter.count();
+  };
+  EXPECT_EQ(count_decode(long_rounds), count_decode(short_rounds));
+}
+
+TEST_P(Allocations, encode) {
+  auto codec = make_codec(GetParam());
+  auto count_encode = [&](size_t nb_rounds) {
+    auto pcm = generate_pcm(codec, nb_rounds);
+    auto inputs = as_inputs(pcm);
+    std::vector<std::byte> output(codec.encoded_size(inputs));
+    AllocationCounter counter;
+    codec.encode(inputs, std::span(output));
+    return counter.count();
+  };
+  EXPECT_EQ(count_encode(long_rounds), count_encode(short_rounds));
+}
+
+TEST_P(Allocations, encode_stream) {
+  auto codec = make_codec(GetParam());
+  auto count_encode = [&](size_t nb_rounds) {
+    auto pcm = generate_pcm(codec, nb_rounds);
+    std::vector<std::istringstream> streams;
+    std::vector<std::istream *> inputs;
+    for (const auto &itm : pcm) {
+      streams.emplace_back(std::string(reinterpret_cast<const char *>(itm.data()), itm.size() * sizeof(int16_t)));
+    }
+    for (auto &itm : streams) {
+      inputs.push_back(&itm);
+    }
+    std::vector<char> output(codec.encoded_size(as_inputs(pcm)));
+    SpanWriter buffer(output);
+    std::ostream stream(&buffer);
+    AllocationCounter counter;
+    codec.encode(inputs, stream);
+    return counter.count();
+  };
+  EXPECT_EQ(count_encode(long_rounds), count_encode(short_rounds));
+}
+
+TEST_P(Allocations, stream_decoder) {
+  auto codec = make_codec(GetParam());
+  std::vector<std::byte> rib;
+  codec.encode(as_inputs(generate_pcm(codec, long_rounds)), rib);
+  std::span<const char> data(reinterpret_cast<const char *>(rib.data()), rib.size());
+  for (uint32_t i = 0; i < codec.count_files(); i++) {
+    RibStreamDecoder decoder(data, codec, i);
+    std::vector<int16_t> output(1000 * codec.nb_channels());
+    AllocationCounter counter;
+    while (decoder.read(output) > 0) {
+    }
+    decoder.seek(decoder.length() / 3);
+    decoder.read(output);
+    EXPECT_EQ(counter.count(), 0);
+  }
+}
+
+TEST_P(Allocations, c_api_stream) {
+  const auto &layout = GetParam();
+  auto codec = make_codec(layout);
+  std::vector<std::byte> rib;
+  codec.encode(as_inputs(generate_pcm(codec, long_rounds)), rib);
+  rib_file *file = nullptr;
+  ASSERT_EQ(rib_open_memory(rib.data(), rib.size(), codec.nb_channels(), layout.frequency, layout.count_files, &file),
+            RIB_OK);
+  rib_stream *stream = nullptr;
+  ASSERT_EQ(rib_stream_create(file, layout.count_files - 1, &stream), RIB_OK);
+  std::vector<int16_t> output(512 * codec.nb_channels());
+  size_t nb_read = 0;
+  AllocationCounter counter;
+  do {
+    ASSERT_EQ(rib_stream_read(stream, output.data(), 512, &nb_read), RIB_OK);
+  } while (nb_read > 0);
+  EXPECT_EQ(counter.count(), 0);
+  rib_stream_destroy(stream);
+  rib_close(file);
+}
+
+INSTANTIATE_TEST_SUITE_P(Layouts, Allocations,
+                         ::testing::Values(Layout{"mono44100", true, 44100, 1}, Layout{"stereo22050", false, 22050, 1},
+                                           Layout{"stereo44100", false, 44100, 1},
+                                           Layout{"complex", false, 22050, 6}),
+                         [](const auto &info) { return std::string(info.param.name); });
@@ -0,0 +1,331 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/**
+ * Performance regression tests. Each test measures PCM throughput of frame kernels or Codec on generated input and
+ * compares it with baseline of build configuration. Test fails when throughput is lower than baseline by more than
+ * tolerance.
+ *
+ * Baseline is taken from RIB_PERF_BASELINE or perf_baseline.json of build tree (recorded with perf_baseline target on
+ * the same machine), tests are skipped when there is none. Tolerance is fraction of baseline, it's taken from
+ * RIB_PERF_TOLERANCE or MANHUNTRIBBER_PERF_TOLERANCE of CMake. With RIB_PERF_UPDATE=1 measured throughput is written
+ * into baseline (of build tree unless RIB_PERF_BASELINE is set) instead of comparison.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "adpcm_codec.h"
+#include "codec.h"
+
+namespace {
+/// Throughput of each test (MB/s of PCM data) by build configuration
+using Baseline = std::map<std::string, std::map<std::string, double>>;
+
+/**
+ * Fastest call is compared, it's least affected by other processes and frequency scaling. Calls are repeated for at
+ * least measure_time and at least min_calls times.
+ */
+constexpr auto measure_time = std::chrono::milliseconds(300);
+constexpr size_t min_calls = 10;
+constexpr double megabyte = 1024 * 1024;
+
+/**
+ * Parser of baseline file: object of configurations, each is object of test names and numbers
+ */
+class BaselineParser {
+public:
+  explicit BaselineParser(std::string text) : m_text(std::move(text)) {}
+
+  Baseline parse() {
+    Baseline baseline;
+    expect('{');
+    while (!accept('}')) {
+      auto config = parse_string();
+      expect(':');
+      expect('{');
+      auto &values = baseline[config];
+      while (!accept('}')) {
+        auto name = parse_string();
+        expect(':');
+        values[name] = parse_number();
+        accept(',');
+      }
+      accept(',');
+    }
+    return baseline;
+  }
+
+private:
+  void skip_spaces() {
+    while (m_pos < m_text.size() && std::isspace((unsigned char)m_text[m_pos])) {
+      m_pos++;
+    }
+  }
+
+  bool accept(char c) {
+    skip_spaces();
+    if (m_pos < m_text.size() && m_text[m_pos] == c) {
+      m_pos++;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!accept(c)) {
+      throw std::runtime_error(std::format("Expected '{}' at offset {} of baseline", c, m_pos));
+    }
+  }
+
+  std::string parse_string() {
+    expect('"');
+    auto end = m_text.find('"', m_pos);
+    if (end == std::string::npos) {
+      throw std::runtime_error("Unterminated string in baseline");
+    }
+    auto result = m_text.substr(m_pos, end - m_pos);
+    m_pos = end + 1;
+    return result;
+  }
+
+  double parse_number() {
+    skip_spaces();
+    size_t size = 0;
+    double value = std::stod(m_text.substr(m_pos), &size);
+    m_pos += size;
+    return value;
+  }
+
+  std::string m_text;
+  size_t m_pos = 0;
+};
+
+Baseline read_baseline(const std::filesystem::path &file) {
+  std::ifstream input(file);
+  if (!input.is_open()) {
+    return {};
+  }
+  std::stringstream text;
+  text << input.rdbuf();
+  return BaselineParser(text.str()).parse();
+}
+
+void write_baseline(const std::filesystem::path &file, const Baseline &baseline) {
+  std::ofstream output(file);
+  if (!output.is_open()) {
+    throw std::runtime_error(std::format("Can't open output file for writing {}", file.string()));
+  }
+  output << "{";
+  for (auto config = baseline.begin(); config != baseline.end(); config++) {
+    output << std::format("{}\n  \"{}\": {{", config == baseline.begin() ? "" : ",", config->first);
+    for (auto itm = config->second.begin(); itm != config->second.end(); itm++) {
+      output << std::format("{}\n    \"{}\": {:.1f}", itm == config->second.begin() ? "" : ",", itm->first,
+                            itm->second);
+    }
+    output << "\n  }";
+  }
+  output << "\n}\n";
+}
+
+std::string environment(const char *name) {
+  const char *value = std::getenv(name);
+  return value ? value : "";
+}
+
+/// Baseline file of this machine, absolute numbers of other machines aren't comparable
+std::filesystem::path baseline_path() {
+  auto path = environment("RIB_PERF_BASELINE");
+  return path.empty() ? RIB_PERF_BUILD_BASELINE : path;
+}
+
+/// Baselines of unoptimized and optimized builds differ several times, so they are kept apart
+std::string build_config() { return std::string(RIB_PERF_CONFIG).empty() ? "default" : RIB_PERF_CONFIG; }
+
+/**
+ * Measure throughput of function processing given bytes of PCM data per call, compare it with baseline and report
+ * the difference
+ */
+template <typename Function> void check_throughput(const std::string &name, size_t pcm_bytes, Function &&function) {
+  using Clock = std::chrono::steady_clock;
+  // Warm up caches and page in buffers
+  function();
+  auto fastest = Clock::duration::max();
+  auto measure_end = Clock::now() + measure_time;
+  for (size_t nb_calls = 0; nb_calls < min_calls || Clock::now() < measure_end; nb_calls++) {
+    auto start = Clock::now();
+    function();
+    fastest = std::min(fastest, Clock::now() - start);
+  }
+  double best = (double)pcm_bytes / megabyte / std::chrono::duration<double>(fastest).count();
+  ::testing::Test::RecordProperty("throughput", std::format("{:.1f}", best));
+
+  auto path = baseline_path();
+  auto baseline = read_baseline(path);
+  if (environment("RIB_PERF_UPDATE") == "1") {
+    baseline[build_config()][name] = best;
+    write_baseline(path, baseline);
+    std::cout << std::format("{}: {:.1f} MB/s recorded into {}\n", name, best, path.string());
+    return;
+  }
+
+  auto config = baseline.find(build_config());
+  if (config == baseline.end() || !config->second.contains(name)) {
+    GTEST_SKIP() << std::format("{}: {:.1f} MB/s, no {} baseline in {}, record it with perf_baseline target", name,
+                                best, build_config(), path.string());
+  }
+  double expected = config->second.at(name);
+  auto tolerance = environment("RIB_PERF_TOLERANCE");
+  double max_regression = tolerance.empty() ? RIB_PERF_TOLERANCE : std::stod(tolerance);
+  double delta = 100.0 * (best - expected) / expected;
+  std::cout << std::format("{}: {:.1f} MB/s, baseline {:.1f} MB/s, delta {:+.1f}%\n", name, best, expected, delta);
+  EXPECT_GE(best, expected * (1 - max_regression))
+      << std::format("{} regressed by {:.1f}% ({:.1f} MB/s, baseline {:.1f} MB/s of {} in {}, tolerance {:.0f}%)",
+                     name, -delta, best, expected, build_config(), path.string(), 100 * max_regression);
+}
+
+/// Deterministic interleaved PCM: tone mixed with noise, loud enough to use whole step index range
+std::vector<int16_t> generate_pcm(size_t nb_samples, uint32_t nb_channels, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<int16_t> samples(nb_samples * nb_channels);
+  for (size_t i = 0; i < nb_samples; i++) {
+    for (uint32_t ch = 0; ch < nb_channels; ch++) {
+      double tone = 16000 * std::sin((double)i * (0.03 + 0.01 * ch));
+      samples[i * nb_channels + ch] = (int16_t)(tone + (double)(random() % 8192) - 4096);
+    }
+  }
+  return samples;
+}
+
+constexpr size_t nb_frames = 256;
+
+size_t frame_samples(uint32_t chunk_size) { return 2 * (chunk_size - 4) + 1; }
+
+/// Frames of one channel encoded from generated PCM
+std::vector<int8_t> generate_frames(uint32_t chunk_size, const std::vector<int16_t> &pcm) {
+  std::vector<int8_t> frames(nb_frames * chunk_size);
+  ADPCMChannelStatus status{};
+  for (size_t k = 0; k < nb_frames; k++) {
+    adpcm_rib_encode_frame(status, std::span(pcm).subspan(k * frame_samples(chunk_size), frame_samples(chunk_size)),
+                           std::span(frames).subspan(k * chunk_size, chunk_size));
+  }
+  return frames;
+}
+} // namespace
+
+class FrameKernels : public ::testing::TestWithParam<uint32_t> {};
+
+TEST_P(FrameKernels, decode) {
+  uint32_t chunk_size = GetParam();
+  auto frames = generate_frames(chunk_size, generate_pcm(nb_frames * frame_samples(chunk_size), 1, chunk_size));
+  std::vector<int16_t> samples(nb_frames * frame_samples(chunk_size));
+  check_throughput(std::format("decode_frame_{:#x}", chunk_size), samples.size() * sizeof(int16_t), [&] {
+    ADPCMChannelStatus status{};
+    for (size_t k = 0; k < nb_frames; k++) {
+      adpcm_rib_decode_frame(std::span(frames).subspan(k * chunk_size, chunk_size),
+                             std::span(samples).subspan(k * frame_samples(chunk_size), frame_samples(chunk_size)),
+                             status);
+    }
+  });
+}
+
+TEST_P(FrameKernels, encode) {
+  uint32_t chunk_size = GetParam();
+  auto samples = generate_pcm(nb_frames * frame_samples(chunk_size), 1, chunk_size);
+  std::vector<int8_t> frames(nb_frames * chunk_size);
+  check_throughput(std::format("encode_frame_{:#x}", chunk_size), samples.size() * sizeof(int16_t), [&] {
+    ADPCMChannelStatus status{};
+    for (size_t k = 0; k < nb_frames; k++) {
+      adpcm_rib_encode_frame(status,
+                             std::span(samples).subspan(k * frame_samples(chunk_size), frame_samples(chunk_size)),
+                             std::span(frames).subspan(k * chunk_size, chunk_size));
+    }
+  });
+}
+
+INSTANTIATE_TEST_SUITE_P(Perf, FrameKernels, ::testing::Values(0x200, 0x400),
+                         [](const auto &info) { return std::format("chunk_{:#x}", info.param); });
+
+namespace {
+struct CodecLayout {
+  const char *name;
+  bool is_mono;
+  uint32_t frequency;
+  uint32_t count_files;
+};
+
+/// Interleaves of each substream
+constexpr size_t nb_interleaves = 2;
+
+void PrintTo(const CodecLayout &layout, std::ostream *output) { *output << layout.name; }
+
+struct CodecInput {
+  std::vector<std::vector<int16_t>> pcm;
+  std::vector<std::span<const std::byte>> inputs;
+  std::vector<std::byte> rib;
+  /// PCM bytes of all substreams
+  size_t pcm_bytes = 0;
+};
+
+CodecInput generate_codec_input(const Codec &codec) {
+  CodecInput input;
+  // Whole interleaves, so that decoded data has same size as source
+  size_t nb_samples = nb_interleaves * codec.interleave_size() / codec.chunk_size() / codec.nb_channels() *
+                      codec.frame_samples();
+  for (uint32_t i = 0; i < codec.count_files(); i++) {
+    const auto &pcm = input.pcm.emplace_back(generate_pcm(nb_samples, codec.nb_channels(), i + 1));
+    input.inputs.push_back(std::as_bytes(std::span(pcm)));
+    input.pcm_bytes += pcm.size() * sizeof(int16_t);
+  }
+  codec.encode(input.inputs, input.rib);
+  return input;
+}
+} // namespace
+
+class CodecLayouts : public ::testing::TestWithParam<CodecLayout> {};
+
+TEST_P(CodecLayouts, decode) {
+  const auto &layout = GetParam();
+  Codec codec(layout.is_mono, layout.frequency, layout.count_files,
+              {.raw_input = true, .raw_output = true, .pcm_endian = std::endian::native});
+  auto input = generate_codec_input(codec);
+  std::vector<std::byte> output(codec.decoded_size(input.rib));
+  check_throughput(std::format("codec_decode_{}", layout.name), input.pcm_bytes, [&] {
+    for (uint32_t i = 0; i < codec.count_files(); i++) {
+      codec.decode(input.rib, std::span(output), i);
+    }
+  });
+}
+
+TEST_P(CodecLayouts, encode) {
+  const auto &layout = GetParam();
+  Codec codec(layout.is_mono, layout.frequency, layout.count_files,
+              {.raw_input = true, .raw_output = true, .pcm_endian = std::endian::native});
+  auto input = generate_codec_input(codec);
+  std::vector<std::byte> output(input.rib.size());
+  check_throughput(std::format("codec_encode_{}", layout.name), input.pcm_bytes,
+                   [&] { codec.encode(input.inputs, std::span(output)); });
+}
+
+INSTANTIATE_TEST_SUITE_P(Perf, CodecLayouts,
+                         ::testing::Values(CodecLayout{"mono44100", true, 44100, 1},
+                                           CodecLayout{"stereo22050", false, 22050, 1},
+                                           CodecLayout{"stereo44100", false, 44100, 1},
+                                           CodecLayout{"complex", false, 22050, 6}),
+                         [](const auto &info) { return std::string(info.param.name); });
@@ -1,12 +1,27 @@
 /* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <format>
 #include <fstream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 #include <gtest/gtest.h>
 
+#include "adpcm_codec.h"
 #include "codec.h"
+#include "compare.h"
+#include "manhuntribber.h"
+#include "perf_counters.h"
+#include "stream_decoder.h"
+#include "trace.h"
 
 const std::filesystem::path orig_rib_1c_44100 = "gs-16b-1c-44100hz.rib";
 const std::filesystem::path orig_wav_1c_44100 = "gs-16b-1c-44100hz.wav";
@@ -25,116 +40,1092 @@ const std::vector<std::filesystem::path> orig_complex_wav = {
 };
 std::filesystem::path orig_complex_rib = "complex.rib";
 
-bool compare_files(const std::filesystem::path &a, const std::filesystem::path &b) {
-  std::ifstream fa(a, std::ios::binary | std::ios::ate);
-  std::ifstream fb(b, std::ios::binary | std::ios::ate);
-
-  if (fa.fail() || fb.fail()) {
-    return false;
-  }
-
-  if (fa.tellg() != fb.tellg()) {
-    return false;
-  }
-
-  fa.seekg(0, std::ios::beg);
-  fb.seekg(0, std::ios::beg);
+/// Directory for output files of running test, ctest runs tests in parallel processes so they must not share files
+std::filesystem::path test_temp_dir() {
+  const auto *info = ::testing::UnitTest::GetInstance()->current_test_info();
+  auto dir = std::filesystem::temp_directory_path() / "manhuntribber_tests" /
+             std::format("{}.{}", info->test_suite_name(), info->name());
+  std::filesystem::create_directories(dir);
+  return dir;
+}
 
-  return std::equal(std::istreambuf_iterator<char>(fa.rdbuf()), std::istreambuf_iterator<char>(),
-                    std::istreambuf_iterator<char>(fb.rdbuf()));
+std::vector<char> read_file(const std::filesystem::path &file) {
+  std::ifstream input(file, std::ios::binary);
+  return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
 }
 
 TEST(MonoSimple44100, decode) {
-  std::filesystem::path gene_wav_1c_44100 = std::filesystem::temp_directory_path() / orig_wav_1c_44100;
+  std::filesystem::path gene_wav_1c_44100 = test_temp_dir() / orig_wav_1c_44100;
 
   Codec codec(true, 44100, 1);
   codec.decode(orig_rib_1c_44100, gene_wav_1c_44100);
 
-  EXPECT_TRUE(compare_files(gene_wav_1c_44100, orig_wav_1c_44100));
+  EXPECT_TRUE(files_equal(gene_wav_1c_44100, orig_wav_1c_44100));
 
   std::filesystem::remove(gene_wav_1c_44100);
 }
 
 TEST(MonoSimple44100, encode) {
-  std::filesystem::path gene_rib_1c_44100 = std::filesystem::temp_directory_path() / orig_rib_1c_44100;
+  std::filesystem::path gene_rib_1c_44100 = test_temp_dir() / orig_rib_1c_44100;
 
   Codec codec(true, 44100, 1);
   codec.encode({orig_wav_1c_44100}, gene_rib_1c_44100);
 
-  EXPECT_TRUE(compare_files(gene_rib_1c_44100, orig_rib_1c_44100));
+  EXPECT_TRUE(files_equal(gene_rib_1c_44100, orig_rib_1c_44100));
 
   std::filesystem::remove(gene_rib_1c_44100);
 }
 
+TEST(MonoSimple44100, decode_partial_interleave) {
+  std::filesystem::path gene_rib_1c_44100 = test_temp_dir() / orig_rib_1c_44100;
+  std::filesystem::path gene_wav_1c_44100 = test_temp_dir() / orig_wav_1c_44100;
+
+  // Cut in the middle of last interleave
+  std::filesystem::copy_file(orig_rib_1c_44100, gene_rib_1c_44100, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::resize_file(gene_rib_1c_44100, 4 * 0x10000 + 0x8000);
+
+  Codec codec(true, 44100, 1);
+  codec.decode(gene_rib_1c_44100, gene_wav_1c_44100);
+
+  auto gene = read_file(gene_wav_1c_44100);
+  auto orig = read_file(orig_wav_1c_44100);
+  ASSERT_EQ(gene.size(), orig.size());
+  size_t content_size = sizeof(wav_hdr) + (4 * 64 + 32) * 2041 * 2;
+  EXPECT_TRUE(std::equal(gene.begin(), gene.begin() + content_size, orig.begin()));
+  EXPECT_TRUE(std::all_of(gene.begin() + content_size, gene.end(), [](char c) { return c == 0; }));
+
+  std::filesystem::remove(gene_rib_1c_44100);
+  std::filesystem::remove(gene_wav_1c_44100);
+}
+
 TEST(StereoSimple44100, decode) {
-  std::filesystem::path gene_wav_2c_44100 = std::filesystem::temp_directory_path() / orig_wav_2c_44100;
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
 
   Codec codec(false, 44100, 1);
   codec.decode(orig_rib_2c_44100, gene_wav_2c_44100);
 
-  EXPECT_TRUE(compare_files(gene_wav_2c_44100, orig_wav_2c_44100));
+  EXPECT_TRUE(files_equal(gene_wav_2c_44100, orig_wav_2c_44100));
+
+  std::filesystem::remove(gene_wav_2c_44100);
+}
+
+TEST(StereoSimple44100, decode_stdout) {
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  std::ofstream output(gene_wav_2c_44100, std::ios::binary);
+
+  auto buf = std::cout.rdbuf(output.rdbuf());
+  Codec codec(false, 44100, 1);
+  codec.decode(orig_rib_2c_44100, "-");
+  std::cout.rdbuf(buf);
+  output.close();
+
+  EXPECT_TRUE(files_equal(gene_wav_2c_44100, orig_wav_2c_44100));
+
+  std::filesystem::remove(gene_wav_2c_44100);
+}
+
+TEST(StereoSimple44100, decode_stdin) {
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  std::ifstream input(orig_rib_2c_44100, std::ios::binary);
+
+  auto buf = std::cin.rdbuf(input.rdbuf());
+  Codec codec(false, 44100, 1);
+  codec.decode("-", gene_wav_2c_44100);
+  std::cin.rdbuf(buf);
+  std::cin.clear();
+
+  EXPECT_TRUE(files_equal(gene_wav_2c_44100, orig_wav_2c_44100));
 
   std::filesystem::remove(gene_wav_2c_44100);
 }
 
 TEST(StereoSimple44100, encode) {
-  std::filesystem::path gene_rib_2c_44100 = std::filesystem::temp_directory_path() / orig_rib_2c_44100;
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
 
   Codec codec(false, 44100, 1);
   codec.encode({orig_wav_2c_44100}, gene_rib_2c_44100);
 
-  EXPECT_TRUE(compare_files(gene_rib_2c_44100, orig_rib_2c_44100));
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
+
+  std::filesystem::remove(gene_rib_2c_44100);
+}
+
+TEST(StereoSimple44100, encode_stdin) {
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
+  std::ifstream input(orig_wav_2c_44100, std::ios::binary);
+  input.seekg(sizeof(wav_hdr));
+
+  auto buf = std::cin.rdbuf(input.rdbuf());
+  Codec codec(false, 44100, 1);
+  codec.encode({"-"}, gene_rib_2c_44100);
+  std::cin.rdbuf(buf);
+  std::cin.clear();
+
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
+
+  std::filesystem::remove(gene_rib_2c_44100);
+}
+
+TEST(StereoSimple22050, encode_stdin_trailing_chunk) {
+  std::filesystem::path gene_wav = test_temp_dir() / orig_wav_2c_22050;
+  std::filesystem::path gene_rib = test_temp_dir() / orig_rib_2c_22050;
+  std::filesystem::path gene_stdin_rib = test_temp_dir() / "stdin.rib";
+
+  // LIST chunk after "data" is not PCM
+  auto orig = read_file(orig_wav_2c_22050);
+  {
+    std::ofstream output(gene_wav, std::ios::binary);
+    output.write(orig.data(), orig.size());
+    output << std::string("LIST\x00\x10\x00\x00", 8) << std::string(0x1000, 'x');
+  }
+
+  Codec codec(false, 22050, 1);
+  codec.encode({gene_wav}, gene_rib);
+
+  std::ifstream input(gene_wav, std::ios::binary);
+  auto info = parse_wav(input);
+  ASSERT_TRUE(info.has_value());
+  auto buf = std::cin.rdbuf(input.rdbuf());
+  codec.encode({"-"}, gene_stdin_rib, info->data_size);
+  std::cin.rdbuf(buf);
+  std::cin.clear();
+
+  EXPECT_TRUE(files_equal(gene_stdin_rib, gene_rib));
+  EXPECT_TRUE(files_equal(gene_stdin_rib, orig_rib_2c_22050));
+
+  std::filesystem::remove(gene_wav);
+  std::filesystem::remove(gene_rib);
+  std::filesystem::remove(gene_stdin_rib);
+}
+
+TEST(StereoSimple44100, raw) {
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
+  std::filesystem::path gene_raw_2c_44100 = test_temp_dir() / "gs-16b-2c-44100hz.raw";
+
+  Codec codec(false, 44100, 1, {.raw_input = true, .raw_output = true});
+  codec.decode(orig_rib_2c_44100, gene_raw_2c_44100);
+
+  auto gene = read_file(gene_raw_2c_44100);
+  auto orig = read_file(orig_wav_2c_44100);
+  ASSERT_EQ(gene.size(), orig.size() - sizeof(wav_hdr));
+  EXPECT_TRUE(std::equal(gene.begin(), gene.end(), orig.begin() + sizeof(wav_hdr)));
+
+  codec.encode({gene_raw_2c_44100}, gene_rib_2c_44100);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
+
+  std::filesystem::remove(gene_rib_2c_44100);
+  std::filesystem::remove(gene_raw_2c_44100);
+}
+
+TEST(StereoSimple44100, encode_metadata) {
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+
+  // Tagged file: odd-sized LIST chunk before data and id3 chunk after it
+  auto orig = read_file(orig_wav_2c_44100);
+  std::string list_chunk("LIST\x05\x00\x00\x00INFO!\x00", 14);
+  std::string id3_chunk("id3 \x04\x00\x00\x00TAG!", 12);
+  {
+    std::ofstream output(gene_wav_2c_44100, std::ios::binary);
+    output.write(orig.data(), 36);
+    output << list_chunk;
+    output.write(orig.data() + 36, orig.size() - 36);
+    output << id3_chunk;
+  }
+
+  auto tagged = read_file(gene_wav_2c_44100);
+  auto info = parse_wav(tagged);
+  ASSERT_TRUE(info.has_value());
+  EXPECT_EQ(info->nb_channels, 2);
+  EXPECT_EQ(info->frequency, 44100);
+  EXPECT_EQ(info->data_offset, sizeof(wav_hdr) + list_chunk.size());
+  EXPECT_EQ(info->data_size, orig.size() - sizeof(wav_hdr));
+
+  std::ifstream input(gene_wav_2c_44100, std::ios::binary);
+  auto stream_info = parse_wav(input);
+  ASSERT_TRUE(stream_info.has_value());
+  EXPECT_EQ(stream_info->data_offset, info->data_offset);
+  EXPECT_EQ((size_t)input.tellg(), info->data_offset);
+
+  Codec codec(false, 44100, 1);
+  codec.encode({gene_wav_2c_44100}, gene_rib_2c_44100);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
+
+  // Chunk larger than the rest of file is rejected before its body is read
+  auto broken = orig;
+  uint32_t huge_size = UTILS::convert_le(0xFFFFFFF0U);
+  std::memcpy(broken.data() + 16, &huge_size, sizeof(huge_size));
+  EXPECT_FALSE(parse_wav(broken).has_value());
+  std::istringstream broken_stream(std::string(broken.begin(), broken.end()));
+  EXPECT_FALSE(parse_wav(broken_stream).has_value());
+
+  std::filesystem::remove(gene_rib_2c_44100);
+  std::filesystem::remove(gene_wav_2c_44100);
+}
+
+TEST(StereoSimple44100, encode_rf64_w64) {
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  auto orig = read_file(orig_wav_2c_44100);
+  std::span<const char> pcm(orig.begin() + sizeof(wav_hdr), orig.end());
+
+  // RF64 header is generated for sizes over 4 GiB only, data is truncated here
+  uint64_t huge_size = 5ULL << 30;
+  auto header = make_wav_header(2, 44100, huge_size);
+  ASSERT_EQ(header.size(), sizeof(wav_hdr) + 36);
+  EXPECT_EQ(std::string(header.data(), 4), "RF64");
+  EXPECT_EQ(make_wav_header(2, 44100, pcm.size()).size(), sizeof(wav_hdr));
+  {
+    std::ofstream output(gene_wav_2c_44100, std::ios::binary);
+    output.write(header.data(), header.size());
+    output.write(pcm.data(), pcm.size());
+  }
+  std::ifstream input(gene_wav_2c_44100, std::ios::binary);
+  auto stream_info = parse_wav(input);
+  ASSERT_TRUE(stream_info.has_value());
+  EXPECT_EQ(stream_info->data_offset, header.size());
+  EXPECT_EQ(stream_info->data_size, huge_size);
+  input.close();
+
+  Codec codec(false, 44100, 1);
+  codec.encode({gene_wav_2c_44100}, gene_rib_2c_44100);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
+
+  // Wave64: GUID chunk ids, 64-bit sizes including chunk header, 8-byte alignment
+  std::string guid_tail("\xF3\xAC\xD3\x11\x8C\xD1\x00\xC0\x4F\x8E\xDB\x8A", 12);
+  auto write_chunk = [](std::ofstream &output, std::string guid, uint64_t size) {
+    output << guid;
+    uint64_t value = UTILS::convert_le(size + 24);
+    output.write(reinterpret_cast<char *>(&value), sizeof(value));
+  };
+  {
+    std::ofstream output(gene_wav_2c_44100, std::ios::binary);
+    write_chunk(output, std::string("riff\x2E\x91\xCF\x11\xA5\xD6\x28\xDB\x04\xC1\x00\x00", 16),
+                16 + 24 + 16 + 24 + 8 + 24 + pcm.size());
+    output << "wave" << guid_tail;
+    write_chunk(output, "fmt " + guid_tail, 16);
+    output.write(orig.data() + 20, 16);
+    write_chunk(output, std::string("junk") + std::string(12, '\0'), 5);
+    output << std::string(8, '\0');
+    write_chunk(output, "data" + guid_tail, pcm.size());
+    output.write(pcm.data(), pcm.size());
+  }
+  auto info = parse_wav(read_file(gene_wav_2c_44100));
+  ASSERT_TRUE(info.has_value());
+  EXPECT_EQ(info->nb_channels, 2);
+  EXPECT_EQ(info->data_offset, 40 + 40 + 32 + 24);
+  EXPECT_EQ(info->data_size, pcm.size());
+
+  // 64-bit chunk size beyond the end of file is rejected before its body is read
+  auto broken = read_file(gene_wav_2c_44100);
+  uint64_t huge_chunk_size = UTILS::convert_le(1ULL << 62);
+  std::memcpy(broken.data() + 40 + 16, &huge_chunk_size, sizeof(huge_chunk_size));
+  EXPECT_FALSE(parse_wav(broken).has_value());
+  std::istringstream broken_stream(std::string(broken.begin(), broken.end()));
+  EXPECT_FALSE(parse_wav(broken_stream).has_value());
+
+  codec.encode({gene_wav_2c_44100}, gene_rib_2c_44100);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
 
   std::filesystem::remove(gene_rib_2c_44100);
+  std::filesystem::remove(gene_wav_2c_44100);
 }
 
 TEST(StereoSimple22050, decode) {
-  std::filesystem::path gene_wav_2c_22050 = std::filesystem::temp_directory_path() / orig_wav_2c_22050;
+  std::filesystem::path gene_wav_2c_22050 = test_temp_dir() / orig_wav_2c_22050;
 
   Codec codec(false, 22050, 1);
   codec.decode(orig_rib_2c_22050, gene_wav_2c_22050);
 
-  EXPECT_TRUE(compare_files(gene_wav_2c_22050, orig_wav_2c_22050));
+  EXPECT_TRUE(files_equal(gene_wav_2c_22050, orig_wav_2c_22050));
 
   std::filesystem::remove(gene_wav_2c_22050);
 }
 
 TEST(StereoSimple22050, encode) {
-  std::filesystem::path gene_rib_2c_22050 = std::filesystem::temp_directory_path() / orig_rib_2c_22050;
+  std::filesystem::path gene_rib_2c_22050 = test_temp_dir() / orig_rib_2c_22050;
 
   Codec codec(false, 22050, 1);
   codec.encode({orig_wav_2c_22050}, gene_rib_2c_22050);
 
-  EXPECT_TRUE(compare_files(gene_rib_2c_22050, orig_rib_2c_22050));
+  EXPECT_TRUE(files_equal(gene_rib_2c_22050, orig_rib_2c_22050));
 
   std::filesystem::remove(gene_rib_2c_22050);
 }
 
 TEST(StereoComplex22050, decode) {
   std::vector<std::filesystem::path> gene_complex_wav = {
-      std::filesystem::temp_directory_path() / "complex_0.wav",
-      std::filesystem::temp_directory_path() / "complex_1.wav",
-      std::filesystem::temp_directory_path() / "complex_2.wav",
-      std::filesystem::temp_directory_path() / "complex_3.wav",
-      std::filesystem::temp_directory_path() / "complex_4.wav",
-      std::filesystem::temp_directory_path() / "complex_5.wav",
+      test_temp_dir() / "complex_0.wav",
+      test_temp_dir() / "complex_1.wav",
+      test_temp_dir() / "complex_2.wav",
+      test_temp_dir() / "complex_3.wav",
+      test_temp_dir() / "complex_4.wav",
+      test_temp_dir() / "complex_5.wav",
   };
 
   Codec codec(false, 22050, 6);
-  codec.decode(orig_complex_rib, std::filesystem::temp_directory_path() / "complex.wav");
+  codec.decode(orig_complex_rib, test_temp_dir() / "complex.wav");
   for (int i = 0; i < 6; i++) {
-    EXPECT_TRUE(compare_files(gene_complex_wav.at(i), orig_complex_wav.at(i)));
+    EXPECT_TRUE(files_equal(gene_complex_wav.at(i), orig_complex_wav.at(i)));
 
     std::filesystem::remove(gene_complex_wav.at(i));
   }
 }
 
+TEST(StereoComplex22050, decode_trim) {
+  Codec codec(false, 22050, 6, {.trim_padding = true});
+  codec.decode(orig_complex_rib, test_temp_dir() / "complex.wav");
+
+  // First two substreams end with silence
+  std::vector<size_t> content_frames = {210, 199, 256, 256, 256, 256};
+  for (int i = 0; i < 6; i++) {
+    std::filesystem::path gene_wav = test_temp_dir() / std::format("complex_{}.wav", i);
+    auto gene = read_file(gene_wav);
+    auto orig = read_file(std::format("complex_{}.wav", i));
+
+    ASSERT_EQ(gene.size(), sizeof(wav_hdr) + content_frames.at(i) * 1017 * 2 * 2);
+    EXPECT_TRUE(std::equal(gene.begin() + sizeof(wav_hdr), gene.end(), orig.begin() + sizeof(wav_hdr)));
+
+    std::filesystem::remove(gene_wav);
+  }
+}
+
 TEST(StereoComplex22050, encode) {
-  std::filesystem::path gene_rib_complex = std::filesystem::temp_directory_path() / orig_complex_rib;
+  std::filesystem::path gene_rib_complex = test_temp_dir() / orig_complex_rib;
 
   Codec codec(false, 22050, 6);
   codec.encode(orig_complex_wav, gene_rib_complex);
 
-  EXPECT_TRUE(compare_files(gene_rib_complex, orig_complex_rib));
+  EXPECT_TRUE(files_equal(gene_rib_complex, orig_complex_rib));
+  std::filesystem::remove(gene_rib_complex);
+}
+
+TEST(StereoComplex22050, demux_mux) {
+  std::filesystem::path gene_rib_complex = test_temp_dir() / orig_complex_rib;
+  std::vector<std::filesystem::path> gene_rib_simple;
+  for (int i = 0; i < 6; i++) {
+    gene_rib_simple.push_back(test_temp_dir() / std::format("complex_{}.rib", i));
+  }
+
+  Codec codec(false, 22050, 6);
+  codec.demux(orig_complex_rib, gene_rib_complex);
+  for (const auto &itm : gene_rib_simple) {
+    EXPECT_EQ(std::filesystem::file_size(itm), 2 * 2 * 0x10000);
+  }
+  codec.mux(gene_rib_simple, gene_rib_complex);
+
+  EXPECT_TRUE(files_equal(gene_rib_complex, orig_complex_rib));
+
+  std::filesystem::remove(gene_rib_complex);
+  for (const auto &itm : gene_rib_simple) {
+    std::filesystem::remove(itm);
+  }
+}
+
+TEST(StereoComplex22050, mux_padding) {
+  std::filesystem::path gene_rib_complex = test_temp_dir() / orig_complex_rib;
+  std::filesystem::path gene_wav_short = test_temp_dir() / "short.wav";
+  std::filesystem::path expected_rib = test_temp_dir() / "expected.rib";
+  std::vector<std::filesystem::path> gene_rib_simple;
+  for (int i = 0; i < 6; i++) {
+    gene_rib_simple.push_back(test_temp_dir() / std::format("complex_{}.rib", i));
+  }
+
+  // Third stream is cut to one interleave (128 frames of 1017 stereo samples)
+  std::filesystem::copy_file(orig_complex_wav.at(3), gene_wav_short,
+                             std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::resize_file(gene_wav_short, sizeof(wav_hdr) + 128 * 1017 * 2 * 2);
+  std::vector<std::filesystem::path> short_complex_wav = orig_complex_wav;
+  short_complex_wav.at(3) = gene_wav_short;
+
+  Codec codec(false, 22050, 6);
+  codec.encode(short_complex_wav, expected_rib);
+
+  codec.demux(orig_complex_rib, gene_rib_complex);
+  std::filesystem::resize_file(gene_rib_simple.at(3), 2 * 0x10000);
+  codec.mux(gene_rib_simple, gene_rib_complex);
+
+  EXPECT_TRUE(files_equal(gene_rib_complex, expected_rib));
+
   std::filesystem::remove(gene_rib_complex);
+  std::filesystem::remove(gene_wav_short);
+  std::filesystem::remove(expected_rib);
+  for (const auto &itm : gene_rib_simple) {
+    std::filesystem::remove(itm);
+  }
+}
+
+TEST(StereoComplex22050, replace_substream) {
+  std::filesystem::path gene_rib_complex = test_temp_dir() / orig_complex_rib;
+  std::filesystem::path expected_rib = test_temp_dir() / "expected.rib";
+
+  std::filesystem::copy_file(orig_complex_rib, gene_rib_complex, std::filesystem::copy_options::overwrite_existing);
+
+  Codec codec(false, 22050, 6);
+  // Same source gives same file
+  codec.replace_substream(gene_rib_complex, 3, orig_complex_wav.at(3));
+  EXPECT_TRUE(files_equal(gene_rib_complex, orig_complex_rib));
+
+  std::vector<std::filesystem::path> replaced_complex_wav = orig_complex_wav;
+  replaced_complex_wav.at(3) = orig_complex_wav.at(0);
+  codec.encode(replaced_complex_wav, expected_rib);
+  codec.replace_substream(gene_rib_complex, 3, orig_complex_wav.at(0));
+  EXPECT_TRUE(files_equal(gene_rib_complex, expected_rib));
+
+  // WAV of another layout would overwrite interleaves of other substreams
+  EXPECT_THROW(codec.replace_substream(gene_rib_complex, 1, orig_wav_1c_44100), std::runtime_error);
+  EXPECT_THROW(codec.replace_substream(gene_rib_complex, 1, orig_wav_2c_44100), std::runtime_error);
+  EXPECT_TRUE(files_equal(gene_rib_complex, expected_rib));
+
+  std::filesystem::remove(gene_rib_complex);
+  std::filesystem::remove(expected_rib);
+}
+
+TEST(StereoComplex22050, replace_substream_longer) {
+  std::filesystem::path gene_rib_complex = test_temp_dir() / orig_complex_rib;
+  std::filesystem::path gene_wav_long = test_temp_dir() / "long.wav";
+  std::filesystem::path expected_rib = test_temp_dir() / "expected.rib";
+
+  // Twice longer stream
+  {
+    std::ifstream fa(orig_complex_wav.at(0), std::ios::binary);
+    std::ifstream fb(orig_complex_wav.at(1), std::ios::binary);
+    std::ofstream out(gene_wav_long, std::ios::binary);
+    out << fa.rdbuf();
+    fb.seekg(sizeof(wav_hdr));
+    out << fb.rdbuf();
+  }
+  std::filesystem::copy_file(orig_complex_rib, gene_rib_complex, std::filesystem::copy_options::overwrite_existing);
+
+  std::vector<std::filesystem::path> replaced_complex_wav = orig_complex_wav;
+  replaced_complex_wav.at(2) = gene_wav_long;
+
+  Codec codec(false, 22050, 6);
+  codec.encode(replaced_complex_wav, expected_rib);
+  codec.replace_substream(gene_rib_complex, 2, gene_wav_long);
+  EXPECT_TRUE(files_equal(gene_rib_complex, expected_rib));
+
+  std::filesystem::remove(gene_rib_complex);
+  std::filesystem::remove(gene_wav_long);
+  std::filesystem::remove(expected_rib);
+}
+
+TEST(StereoSimple44100, encode_incremental) {
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  std::filesystem::path manifest = gene_rib_2c_44100;
+  manifest += ".manifest";
+  std::filesystem::path expected_rib = test_temp_dir() / "expected.rib";
+
+  std::filesystem::copy_file(orig_rib_2c_44100, gene_rib_2c_44100, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::copy_file(orig_wav_2c_44100, gene_wav_2c_44100, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::remove(manifest);
+
+  auto edit_wav = [&](size_t offset) {
+    std::fstream wav(gene_wav_2c_44100, std::ios::binary | std::ios::in | std::ios::out);
+    wav.seekp(sizeof(wav_hdr) + offset);
+    for (int i = 0; i < 4000; i++) {
+      int16_t sample = (int16_t)(i * 7919);
+      wav.write(reinterpret_cast<char *>(&sample), sizeof(sample));
+    }
+  };
+
+  Codec codec(false, 44100, 1);
+
+  // Without manifest, edit is inside interleave 1
+  edit_wav(600000);
+  codec.encode({gene_wav_2c_44100}, expected_rib);
+  EXPECT_EQ(codec.encode_incremental({gene_wav_2c_44100}, gene_rib_2c_44100), 1);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, expected_rib));
+  EXPECT_TRUE(std::filesystem::exists(manifest));
+
+  // With manifest, edit is inside interleave 2
+  edit_wav(1500000);
+  codec.encode({gene_wav_2c_44100}, expected_rib);
+  EXPECT_EQ(codec.encode_incremental({gene_wav_2c_44100}, gene_rib_2c_44100), 1);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, expected_rib));
+  EXPECT_EQ(codec.encode_incremental({gene_wav_2c_44100}, gene_rib_2c_44100), 0);
+
+  // Stale manifest: full encode of original WAV replaces RIB, manifest still describes edited WAV, so both edited
+  // interleaves are restored
+  codec.encode({orig_wav_2c_44100}, gene_rib_2c_44100);
+  EXPECT_EQ(codec.encode_incremental({gene_wav_2c_44100}, gene_rib_2c_44100), 2);
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, expected_rib));
+
+  std::filesystem::remove(gene_rib_2c_44100);
+  std::filesystem::remove(gene_wav_2c_44100);
+  std::filesystem::remove(manifest);
+  std::filesystem::remove(expected_rib);
+}
+
+TEST(Kernels, silent_frame_encode) {
+  std::vector<int16_t> silence(2041, 0);
+  std::vector<int16_t> almost_silence(2041, 0);
+  almost_silence.back() = 1000;
+
+  for (int16_t step_index = 0; step_index < 89; step_index++) {
+    ADPCMChannelStatus fast{0, step_index, 0};
+    ADPCMChannelStatus slow{0, step_index, 0};
+    std::vector<int8_t> fast_frame(0x400);
+    std::vector<int8_t> slow_frame(0x400);
+
+    adpcm_rib_encode_frame(fast, silence, fast_frame);
+    adpcm_rib_encode_frame(slow, almost_silence, slow_frame);
+
+    // Only last nibble differs
+    EXPECT_TRUE(std::equal(fast_frame.begin(), fast_frame.end() - 1, slow_frame.begin()));
+    EXPECT_EQ(fast.step_index, 0);
+    EXPECT_EQ(fast.prev_sample, 0);
+  }
+}
+
+TEST(Kernels, silent_frame_decode) {
+  std::vector<int8_t> frame(0x200, 0);
+  std::vector<int16_t> decoded(1017, 1);
+  ADPCMChannelStatus status{1, 1, 1};
+
+  EXPECT_TRUE(adpcm_rib_is_silent_frame(frame));
+  adpcm_rib_decode_frame(frame, decoded, status);
+  EXPECT_TRUE(std::all_of(decoded.begin(), decoded.end(), [](int16_t sample) { return sample == 0; }));
+  EXPECT_EQ(status.predictor, 0);
+  EXPECT_EQ(status.step_index, 0);
+
+  frame.at(0x1FF) = 1;
+  EXPECT_FALSE(adpcm_rib_is_silent_frame(frame));
+}
+
+TEST(Kernels, corrupt_header_decode) {
+  auto rib = read_file(orig_rib_1c_44100);
+  std::vector<int8_t> frame(rib.begin(), rib.begin() + 0x400);
+  std::vector<int16_t> expected(2041);
+  std::vector<int16_t> decoded(2041);
+
+  // Step index of header out of 0..88 decodes as nearest valid one
+  for (auto [corrupt, valid] : {std::pair<int8_t, int8_t>{127, 88}, {89, 88}, {-1, 0}, {-128, 0}}) {
+    ADPCMChannelStatus status{};
+    frame.at(2) = valid;
+    adpcm_rib_decode_frame(frame, expected, status);
+    frame.at(2) = corrupt;
+    adpcm_rib_decode_frame(frame, decoded, status);
+    EXPECT_EQ(decoded, expected);
+    EXPECT_GE(status.step_index, 0);
+    EXPECT_LE(status.step_index, 88);
+  }
+
+  // Arbitrary buffers passed to C API decode without reading outside of step table
+  std::vector<char> garbage(0x20000);
+  for (size_t i = 0; i < garbage.size(); i++) {
+    garbage.at(i) = (char)(i * 7919 >> 3);
+  }
+  rib_file *file = nullptr;
+  ASSERT_EQ(rib_open_memory(garbage.data(), garbage.size(), 2, 44100, 1, &file), RIB_OK);
+  std::vector<int16_t> samples(64 * 2041 * 2);
+  size_t nb_decoded;
+  EXPECT_EQ(rib_decode(file, 0, 0, samples.data(), 64 * 2041, &nb_decoded), RIB_OK);
+  EXPECT_EQ(nb_decoded, 64 * 2041);
+  rib_close(file);
+}
+
+TEST(Kernels, counters) {
+  auto rib = read_file(orig_rib_2c_22050);
+  std::span<const int8_t> frames(reinterpret_cast<const int8_t *>(rib.data()), 0x10000);
+  ADPCMCounters counters;
+  ADPCMNoCounters no_counters;
+  size_t nb_frames = 0;
+
+  // Counting doesn't change output, zero frames are counted too
+  for (size_t pos = 0; pos < frames.size(); pos += 0x200, nb_frames++) {
+    std::vector<int16_t> counted(1017);
+    std::vector<int16_t> uncounted(1017);
+    ADPCMChannelStatus counted_status{};
+    ADPCMChannelStatus uncounted_status{};
+    adpcm_rib_decode_frame(frames.subspan(pos, 0x200), counted, counted_status, counters);
+    adpcm_rib_decode_frame(frames.subspan(pos, 0x200), uncounted, uncounted_status, no_counters);
+    EXPECT_EQ(counted, uncounted);
+  }
+  EXPECT_EQ(counters.samples(), nb_frames * 1016);
+  EXPECT_EQ(std::accumulate(counters.step_indexes.begin(), counters.step_indexes.end(), uint64_t{0}),
+            counters.samples());
+
+  // Full scale square wave drives encoder to the top of step table and clips its reconstruction
+  std::vector<int16_t> square(2041);
+  for (size_t i = 0; i < square.size(); i++) {
+    square.at(i) = (i / 8) % 2 ? 32767 : -32768;
+  }
+  ADPCMCounters encode_counters;
+  ADPCMChannelStatus status{};
+  std::vector<int8_t> encoded(0x400);
+  adpcm_rib_encode_frame(status, square, encoded, encode_counters);
+  EXPECT_EQ(encode_counters.samples(), 2040);
+  EXPECT_GT(encode_counters.clips, 0);
+  EXPECT_GT(encode_counters.step_index_clamps, 0);
+  EXPECT_GT(encode_counters.step_indexes.at(88), 0);
+
+  counters += encode_counters;
+  EXPECT_EQ(counters.samples(), nb_frames * 1016 + 2040);
+}
+
+#ifdef MANHUNTRIBBER_KERNEL_COUNTERS
+TEST(StereoComplex22050, kernel_counters) {
+  std::filesystem::path gene_rib = test_temp_dir() / orig_complex_rib;
+  std::vector<ADPCMCounters> counters;
+
+  Codec codec(false, 22050, 6, {.kernel_counters = &counters});
+  codec.encode(orig_complex_wav, gene_rib);
+  EXPECT_TRUE(files_equal(gene_rib, orig_complex_rib));
+
+  // Every substream is padded to the same number of interleaves, first sample of each frame is stored as is
+  size_t nb_rounds = std::filesystem::file_size(orig_complex_rib) / (6 * 0x20000);
+  ASSERT_EQ(counters.size(), 6);
+  for (const auto &itm : counters) {
+    EXPECT_EQ(itm.samples(), nb_rounds * 128 * 2 * 1016);
+  }
+
+  std::filesystem::remove(gene_rib);
+}
+#endif
+
+TEST(Memory, decode) {
+  auto rib = read_file(orig_complex_rib);
+  Codec codec(false, 22050, 6);
+  for (uint32_t i = 0; i < 6; i++) {
+    std::vector<std::byte> output;
+    codec.decode(std::as_bytes(std::span(rib)), output, i);
+    auto orig = read_file(std::format("complex_{}.wav", i));
+    EXPECT_EQ(output.size(), orig.size());
+    EXPECT_TRUE(std::equal(output.begin(), output.end(), std::as_bytes(std::span(orig)).begin()));
+  }
+
+  // Preallocated buffer, trimmed raw output is a prefix of PCM data
+  Codec trim_codec(false, 22050, 6, {.trim_padding = true, .raw_output = true});
+  auto orig = read_file("complex_1.wav");
+  std::vector<std::byte> output(orig.size());
+  uint64_t size = trim_codec.decoded_size(std::as_bytes(std::span(rib)), 1);
+  EXPECT_EQ(size, 199 * 1017 * 2 * 2);
+  EXPECT_EQ(trim_codec.decode(std::as_bytes(std::span(rib)), std::span(output), 1), size);
+  EXPECT_TRUE(
+      std::equal(output.begin(), output.begin() + size, std::as_bytes(std::span(orig)).begin() + sizeof(wav_hdr)));
+
+  EXPECT_THROW(codec.decode(std::as_bytes(std::span(rib)), std::span(output).first(size), 1), std::runtime_error);
+  EXPECT_THROW(codec.decode(std::as_bytes(std::span(rib)), output, 6), std::runtime_error);
+}
+
+TEST(Memory, encode) {
+  std::vector<std::vector<char>> wavs;
+  std::vector<std::span<const std::byte>> inputs;
+  for (const auto &itm : orig_complex_wav) {
+    inputs.push_back(std::as_bytes(std::span(wavs.emplace_back(read_file(itm)))));
+  }
+  auto orig = read_file(orig_complex_rib);
+
+  Codec codec(false, 22050, 6);
+  EXPECT_EQ(codec.encoded_size(inputs), orig.size());
+  std::vector<std::byte> output;
+  codec.encode(inputs, output);
+  EXPECT_TRUE(std::ranges::equal(output, std::as_bytes(std::span(orig))));
+
+  std::vector<std::byte> small(orig.size() - 1);
+  EXPECT_THROW(codec.encode(inputs, std::span(small)), std::runtime_error);
+  inputs.pop_back();
+  EXPECT_THROW(codec.encode(inputs, output), std::runtime_error);
+}
+
+TEST(StreamDecoder, read_seek) {
+  auto rib = read_file(orig_complex_rib);
+  auto orig = read_file("complex_4.wav");
+  std::span<const int16_t> pcm(reinterpret_cast<const int16_t *>(orig.data() + sizeof(wav_hdr)),
+                               (orig.size() - sizeof(wav_hdr)) / sizeof(int16_t));
+
+  Codec codec(false, 22050, 6);
+  RibStreamDecoder decoder(rib, codec, 4);
+  EXPECT_EQ(decoder.length() * 2, pcm.size());
+
+  // Reads of audio callback size cross frame and interleave boundaries
+  std::vector<int16_t> samples(2 * 441);
+  for (size_t position = 0; position < pcm.size(); position += samples.size()) {
+    size_t nb_values = decoder.read(samples);
+    ASSERT_EQ(nb_values, std::min(samples.size(), pcm.size() - position));
+    ASSERT_TRUE(std::equal(samples.begin(), samples.begin() + nb_values, pcm.begin() + position));
+    // Past the end output is filled with silence
+    ASSERT_TRUE(std::all_of(samples.begin() + nb_values, samples.end(), [](int16_t s) { return s == 0; }));
+  }
+  EXPECT_EQ(decoder.position(), decoder.length());
+  EXPECT_EQ(decoder.read(samples), 0);
+
+  for (uint64_t position : {65000ULL, 1016ULL, 0ULL, 64 * 1017ULL - 3}) {
+    decoder.seek(position);
+    EXPECT_EQ(decoder.read(samples), samples.size());
+    EXPECT_TRUE(std::equal(samples.begin(), samples.end(), pcm.begin() + position * 2));
+  }
+  EXPECT_THROW(RibStreamDecoder(rib, codec, 6), std::runtime_error);
+}
+
+TEST(StreamDecoder, background) {
+  auto rib = read_file(orig_complex_rib);
+  auto orig = read_file("complex_2.wav");
+  std::span<const int16_t> pcm(reinterpret_cast<const int16_t *>(orig.data() + sizeof(wav_hdr)),
+                               (orig.size() - sizeof(wav_hdr)) / sizeof(int16_t));
+
+  Codec codec(false, 22050, 6);
+  RibBackgroundDecoder decoder(rib, codec, 2);
+  // First frame is ready right after construction
+  auto first = decoder.available();
+  ASSERT_GE(first.size(), 1017 * 2);
+  EXPECT_TRUE(std::equal(first.begin(), first.end(), pcm.begin()));
+
+  decoder.wait();
+  EXPECT_TRUE(decoder.is_done());
+  EXPECT_TRUE(std::ranges::equal(decoder.available(), pcm));
+}
+
+TEST(CApi, decode) {
+  rib_file *file = nullptr;
+  ASSERT_EQ(rib_open_file(orig_complex_rib.string().c_str(), 2, 22050, 6, &file), RIB_OK);
+  rib_layout layout;
+  ASSERT_EQ(rib_get_layout(file, &layout), RIB_OK);
+  EXPECT_EQ(layout.nb_channels, 2);
+  EXPECT_EQ(layout.nb_substreams, 6);
+  EXPECT_EQ(layout.chunk_size, 0x200);
+  EXPECT_EQ(layout.interleave_size, 0x20000);
+
+  for (uint32_t i = 0; i < 6; i++) {
+    auto orig = read_file(std::format("complex_{}.wav", i));
+    ASSERT_EQ(layout.nb_samples[i] * 2 * sizeof(int16_t), orig.size() - sizeof(wav_hdr));
+
+    // Odd-sized reads cross frame and interleave boundaries
+    std::vector<int16_t> samples(layout.nb_samples[i] * 2);
+    size_t position = 0;
+    size_t nb_decoded;
+    do {
+      ASSERT_EQ(rib_decode(file, i, position, samples.data() + position * 2, 777, &nb_decoded), RIB_OK);
+      position += nb_decoded;
+    } while (nb_decoded > 0);
+    EXPECT_EQ(position, layout.nb_samples[i]);
+    EXPECT_EQ(std::memcmp(samples.data(), orig.data() + sizeof(wav_hdr), samples.size() * sizeof(int16_t)), 0);
+  }
+  int16_t sample;
+  size_t nb_decoded;
+  EXPECT_EQ(rib_decode(file, 6, 0, &sample, 1, &nb_decoded), RIB_ERROR_OUT_OF_RANGE);
+  rib_close(file);
+
+  EXPECT_EQ(rib_open_file("missing.rib", 2, 22050, 6, &file), RIB_ERROR_IO);
+  EXPECT_EQ(rib_open_file(orig_complex_rib.string().c_str(), 2, 32000, 6, &file), RIB_ERROR_INVALID_ARGUMENT);
+
+  auto rib = read_file(orig_rib_1c_44100);
+  auto orig = read_file(orig_wav_1c_44100);
+  ASSERT_EQ(rib_open_memory(rib.data(), rib.size(), 1, 44100, 1, &file), RIB_OK);
+  std::vector<int16_t> samples(5000);
+  ASSERT_EQ(rib_decode(file, 0, 2040, samples.data(), samples.size(), &nb_decoded), RIB_OK);
+  EXPECT_EQ(nb_decoded, samples.size());
+  EXPECT_EQ(std::memcmp(samples.data(), orig.data() + sizeof(wav_hdr) + 2040 * 2, samples.size() * 2), 0);
+  rib_close(file);
+}
+
+TEST(CApi, stream) {
+  rib_file *file = nullptr;
+  ASSERT_EQ(rib_open_file(orig_rib_2c_22050.string().c_str(), 2, 22050, 1, &file), RIB_OK);
+  rib_stream *stream = nullptr;
+  ASSERT_EQ(rib_stream_create(file, 0, &stream), RIB_OK);
+  auto orig = read_file(orig_wav_2c_22050);
+
+  std::vector<int16_t> samples(256 * 2);
+  size_t nb_read;
+  ASSERT_EQ(rib_stream_seek(stream, 1000), RIB_OK);
+  ASSERT_EQ(rib_stream_read(stream, samples.data(), 256, &nb_read), RIB_OK);
+  EXPECT_EQ(nb_read, 256);
+  EXPECT_EQ(std::memcmp(samples.data(), orig.data() + sizeof(wav_hdr) + 1000 * 4, samples.size() * 2), 0);
+
+  rib_stream *missing;
+  EXPECT_EQ(rib_stream_create(file, 1, &missing), RIB_ERROR_OUT_OF_RANGE);
+  rib_stream_destroy(stream);
+  rib_close(file);
+}
+
+TEST(CApi, encode) {
+  std::vector<std::vector<char>> wavs;
+  std::vector<const int16_t *> samples;
+  std::vector<size_t> nb_samples;
+  for (const auto &itm : orig_complex_wav) {
+    auto &wav = wavs.emplace_back(read_file(itm));
+    auto info = parse_wav(wav);
+    ASSERT_TRUE(info.has_value());
+    samples.push_back(reinterpret_cast<const int16_t *>(wav.data() + info->data_offset));
+    nb_samples.push_back(info->data_size / 4);
+  }
+
+  std::vector<char> rib;
+  auto sink = [](void *user_data, const void *data, size_t size) {
+    auto output = static_cast<std::vector<char> *>(user_data);
+    output->insert(output->end(), static_cast<const char *>(data), static_cast<const char *>(data) + size);
+    return 0;
+  };
+  ASSERT_EQ(rib_encode(2, 22050, 6, samples.data(), nb_samples.data(), sink, &rib), RIB_OK);
+  EXPECT_EQ(rib, read_file(orig_complex_rib));
+
+  auto failing_sink = [](void *, const void *, size_t) { return 1; };
+  EXPECT_EQ(rib_encode(2, 22050, 6, samples.data(), nb_samples.data(), failing_sink, nullptr), RIB_ERROR_SINK);
+  EXPECT_EQ(rib_encode(2, 22050, 1, samples.data(), nb_samples.data(), nullptr, nullptr), RIB_ERROR_INVALID_ARGUMENT);
+}
+
+TEST(Stats, decode_encode) {
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  std::filesystem::path gene_rib_2c_44100 = test_temp_dir() / orig_rib_2c_44100;
+  CodecStats decode_stats;
+  CodecStats encode_stats;
+
+  Codec decoder(false, 44100, 1, {.stats = &decode_stats});
+  decoder.decode(orig_rib_2c_44100, gene_wav_2c_44100);
+  Codec encoder(false, 44100, 1, {.stats = &encode_stats});
+  encoder.encode({orig_wav_2c_44100}, gene_rib_2c_44100);
+
+  // Measurement doesn't change output
+  EXPECT_TRUE(files_equal(gene_wav_2c_44100, orig_wav_2c_44100));
+  EXPECT_TRUE(files_equal(gene_rib_2c_44100, orig_rib_2c_44100));
+
+  EXPECT_EQ(decode_stats.nb_files, 1);
+  EXPECT_EQ(decode_stats.input_bytes, std::filesystem::file_size(orig_rib_2c_44100));
+  EXPECT_EQ(decode_stats.output_bytes, std::filesystem::file_size(orig_wav_2c_44100));
+  EXPECT_EQ(decode_stats.samples, (std::filesystem::file_size(orig_wav_2c_44100) - sizeof(wav_hdr)) / 4);
+  EXPECT_GT(decode_stats.phase_ns[static_cast<size_t>(Phase::Kernel)], 0);
+  EXPECT_EQ(encode_stats.output_bytes, std::filesystem::file_size(orig_rib_2c_44100));
+  EXPECT_EQ(encode_stats.samples, decode_stats.samples);
+  EXPECT_GT(encode_stats.phase_ns[static_cast<size_t>(Phase::Kernel)], 0);
+
+  CodecStats total = decode_stats;
+  total += encode_stats;
+  EXPECT_EQ(total.nb_files, 2);
+  EXPECT_EQ(total.total_ns(), decode_stats.total_ns() + encode_stats.total_ns());
+
+  std::filesystem::remove(gene_wav_2c_44100);
+  std::filesystem::remove(gene_rib_2c_44100);
+}
+
+TEST(Stats, perf_counters) {
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  PerfCounters perf;
+  CodecStats stats;
+  stats.perf = &perf;
+
+  Codec codec(false, 44100, 1, {.stats = &stats});
+  codec.decode(orig_rib_2c_44100, gene_wav_2c_44100);
+  EXPECT_TRUE(files_equal(gene_wav_2c_44100, orig_wav_2c_44100));
+
+  // Counters may be missing (virtual machines, restricted perf_event_paranoid), conversion goes on without them
+  auto counts = stats.total_counts();
+  if (perf.is_available()) {
+    EXPECT_NE(counts.mask, 0);
+  } else {
+    EXPECT_EQ(counts.mask, 0);
+    EXPECT_FALSE(perf.error().empty());
+  }
+
+  PerfCounts a{{100, 250, 5, 0, 0}, 0b111};
+  PerfCounts b{{40, 50, 1, 0, 0}, 0b011};
+  auto delta = a - b;
+  EXPECT_EQ(delta.mask, 0b011);
+  EXPECT_EQ(delta[PerfEvent::Cycles], 60);
+  EXPECT_EQ(delta[PerfEvent::Instructions], 200);
+  EXPECT_EQ(delta.summary(), "cycles 0.00M, instructions 0.00M (IPC 3.33)");
+
+  std::filesystem::remove(gene_wav_2c_44100);
+}
+
+TEST(Stats, memory_budget) {
+  std::filesystem::path gene_wav = test_temp_dir() / "rib_budget.wav";
+  std::filesystem::path gene_rib = test_temp_dir() / "rib_budget.rib";
+  size_t interleave_size = 2 * 0x10000;
+  Codec codec(false, 22050, 6);
+
+  // Budget smaller than codec buffers fails before any output is created
+  Codec small_decoder(false, 22050, 6, {.max_memory = codec.decode_buffers_size() - 1});
+  EXPECT_THROW(small_decoder.decode(orig_complex_rib, gene_wav), std::runtime_error);
+  EXPECT_FALSE(std::filesystem::exists(test_temp_dir() / "rib_budget_0.wav"));
+  Codec small_encoder(false, 22050, 6, {.max_memory = codec.encode_buffers_size() - 1});
+  EXPECT_THROW(small_encoder.encode(orig_complex_wav, gene_rib), std::runtime_error);
+  EXPECT_FALSE(std::filesystem::exists(gene_rib));
+
+  // Pages of input beyond budget are released as conversion goes, output stays the same
+  CodecStats decode_stats;
+  Codec decoder(false, 22050, 6,
+                {.stats = &decode_stats, .max_memory = codec.decode_buffers_size() + 2 * interleave_size});
+  decoder.decode(orig_complex_rib, gene_wav);
+  for (uint32_t i = 0; i < 6; i++) {
+    auto file = test_temp_dir() / std::format("rib_budget_{}.wav", i);
+    EXPECT_TRUE(files_equal(file, std::format("complex_{}.wav", i)));
+    std::filesystem::remove(file);
+  }
+  EXPECT_GT(decode_stats.released_bytes, 0);
+  EXPECT_LE(decode_stats.released_bytes, std::filesystem::file_size(orig_complex_rib));
+  EXPECT_GT(decode_stats.buffer_peak_bytes, 0);
+  EXPECT_LE(decode_stats.buffer_peak_bytes, codec.decode_buffers_size());
+  EXPECT_GE(decode_stats.buffer_allocated_bytes, decode_stats.buffer_peak_bytes);
+#ifdef __linux__
+  EXPECT_GT(decode_stats.peak_rss, 0);
+#endif
+
+  CodecStats encode_stats;
+  Codec encoder(false, 22050, 6, {.stats = &encode_stats, .max_memory = codec.encode_buffers_size() + 6 * 0x10000});
+  encoder.encode(orig_complex_wav, gene_rib);
+  EXPECT_TRUE(files_equal(gene_rib, orig_complex_rib));
+  EXPECT_GT(encode_stats.released_bytes, 0);
+  EXPECT_GT(encode_stats.buffer_peak_bytes, 0);
+  EXPECT_LE(encode_stats.buffer_peak_bytes, codec.encode_buffers_size());
+
+  // Without budget nothing is released
+  CodecStats stats;
+  Codec unlimited(false, 22050, 6, {.stats = &stats});
+  unlimited.encode(orig_complex_wav, gene_rib);
+  EXPECT_EQ(stats.released_bytes, 0);
+  EXPECT_EQ(stats.buffer_peak_bytes, encode_stats.buffer_peak_bytes);
+
+  std::filesystem::remove(gene_rib);
+}
+
+TEST(Compare, rib) {
+  Codec codec(false, 22050, 6);
+  auto orig = read_file(orig_complex_rib);
+  EXPECT_TRUE(compare_rib(orig_complex_rib, orig_complex_rib, codec).is_equal());
+
+  // Frame 3 of right channel in interleave 7 is the second interleave of substream 1
+  auto gene = orig;
+  size_t offset = 7 * 0x20000 + 0x10000 + 3 * 0x200;
+  gene.at(offset + 100) ^= 1;
+  gene.at(offset + 101) ^= 1;
+  auto result = compare_rib(orig, gene, codec);
+  EXPECT_FALSE(result.is_equal());
+  EXPECT_EQ(result.nb_frames, orig.size() / 0x200);
+  ASSERT_EQ(result.frames.size(), 1);
+  const auto &frame = result.frames.front();
+  EXPECT_EQ(frame.interleave, 7);
+  EXPECT_EQ(frame.substream, 1);
+  EXPECT_EQ(frame.channel, 1);
+  EXPECT_EQ(frame.frame, 128 + 3);
+  EXPECT_EQ(frame.first_sample, (128 + 3) * codec.frame_samples());
+  EXPECT_EQ(frame.offset, offset);
+  EXPECT_EQ(result.interleaves(), std::vector<uint64_t>{7});
+  EXPECT_EQ(result.substreams(), std::vector<uint32_t>{1});
+
+  // Extra bytes of longer file are reported by sizes only
+  gene.at(0) ^= 1;
+  gene.resize(orig.size() - 0x20000);
+  result = compare_rib(orig, gene, codec);
+  EXPECT_EQ(result.size_b, orig.size() - 0x20000);
+  EXPECT_EQ(result.frames.size(), 2);
+  EXPECT_EQ(result.substreams(), (std::vector<uint32_t>{0, 1}));
+}
+
+TEST(Compare, wav) {
+  auto orig = read_file(orig_wav_2c_44100);
+  auto result = compare_wav(orig, orig);
+  EXPECT_TRUE(result.is_equal());
+  EXPECT_EQ(result.nb_samples_a, (orig.size() - sizeof(wav_hdr)) / 4);
+
+  // Right channel of sample 1000 is changed by 300, left channel of sample 2000 by -4
+  auto gene = orig;
+  auto add = [&](size_t sample, uint32_t channel, int16_t delta) {
+    size_t offset = sizeof(wav_hdr) + sample * 4 + channel * 2;
+    int16_t value;
+    std::memcpy(&value, gene.data() + offset, sizeof(value));
+    value = UTILS::convert_le((int16_t)(UTILS::convert_le(value) + delta));
+    std::memcpy(gene.data() + offset, &value, sizeof(value));
+  };
+  add(1000, 1, 300);
+  add(2000, 0, -4);
+  result = compare_wav(orig, gene);
+  EXPECT_FALSE(result.is_equal());
+  EXPECT_EQ(result.nb_differences, 2);
+  ASSERT_TRUE(result.first_sample.has_value());
+  EXPECT_EQ(*result.first_sample, 1000);
+  EXPECT_EQ(result.first_channel, 1);
+  EXPECT_EQ(result.max_difference, 300);
+  EXPECT_DOUBLE_EQ(result.rms_difference, std::sqrt((300.0 * 300 + 4 * 4) / ((orig.size() - sizeof(wav_hdr)) / 2)));
+
+  // Files of different formats, not WAV files and malformed headers are rejected
+  EXPECT_THROW(static_cast<void>(compare_wav(read_file(orig_wav_1c_44100), orig)), std::runtime_error);
+  EXPECT_THROW(static_cast<void>(compare_wav(read_file(orig_wav_2c_22050), orig)), std::runtime_error);
+  EXPECT_THROW(static_cast<void>(compare_wav(orig, read_file(orig_rib_2c_44100))), std::runtime_error);
+  auto no_channels = orig;
+  no_channels.at(22) = 0;
+  no_channels.at(23) = 0;
+  EXPECT_THROW(static_cast<void>(compare_wav(no_channels, no_channels)), std::runtime_error);
+}
+
+TEST(Trace, threads) {
+  std::filesystem::path gene_wav_2c_44100 = test_temp_dir() / orig_wav_2c_44100;
+  std::filesystem::path trace_file = test_temp_dir() / "rib_trace.json";
+  Tracer::enable();
+
+  Codec codec(false, 44100, 1);
+  codec.decode(orig_rib_2c_44100, gene_wav_2c_44100);
+  MappedFile rib(orig_rib_2c_44100);
+  RibBackgroundDecoder decoder(rib.data(), codec);
+  decoder.wait();
+
+  // Spans of several threads, more of them than fits into one chunk of buffer
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 3; i++) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 5000; j++) {
+        TraceSpan span("test span", j);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  Tracer::write(trace_file);
+
+  std::ifstream input(trace_file);
+  std::map<std::string, size_t> counts;
+  std::set<std::string> tids;
+  for (std::string line; std::getline(input, line);) {
+    auto name = line.find("\"name\": \"");
+    if (name != std::string::npos) {
+      counts[line.substr(name + 9, line.find('"', name + 9) - name - 9)]++;
+    }
+    auto tid = line.find("\"tid\": ");
+    if (tid != std::string::npos) {
+      tids.insert(line.substr(tid + 7, line.find(',', tid) - tid - 7));
+    }
+  }
+  EXPECT_EQ(counts["test span"], 15000);
+  EXPECT_EQ(counts["decode"], 1);
+  EXPECT_EQ(counts["decode interleave"], (std::filesystem::file_size(orig_rib_2c_44100) + 0x1ffff) / 0x20000);
+  EXPECT_EQ(counts["kernel"], counts["decode interleave"]);
+  EXPECT_EQ(counts["wait"], 1);
+  EXPECT_GT(counts["decode frame"], 0);
+  EXPECT_EQ(counts["thread_name"], 1);
+  // Main, background decoder and test threads
+  EXPECT_EQ(tids.size(), 5);
+
+  Tracer::disable();
+  EXPECT_FALSE(Tracer::is_enabled());
+  std::filesystem::remove(gene_wav_2c_44100);
+  std::filesystem::remove(trace_file);
+}
+
+TEST(Trace, escape_thread_name) {
+  std::filesystem::path trace_file = test_temp_dir() / "rib_trace.json";
+  Tracer::enable();
+  Tracer::set_thread_name("quote \" backslash \\ tab \t");
+  { TraceSpan span("test span"); }
+  Tracer::write(trace_file);
+  Tracer::disable();
+
+  std::ifstream input(trace_file);
+  std::stringstream text;
+  text << input.rdbuf();
+  EXPECT_NE(text.str().find(R"("args": {"name": "quote \" backslash \\ tab \u0009"})"), std::string::npos);
+  EXPECT_EQ(text.str().find('\t'), std::string::npos);
+
+  // Spans and names recorded before disable() aren't written again
+  Tracer::enable();
+  Tracer::write(trace_file);
+  Tracer::disable();
+  std::ifstream again(trace_file);
+  std::stringstream empty_text;
+  empty_text << again.rdbuf();
+  EXPECT_EQ(empty_text.str().find("test span"), std::string::npos);
+  EXPECT_EQ(empty_text.str().find("thread_name"), std::string::npos);
+  std::filesystem::remove(trace_file);
 }
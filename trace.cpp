@@ -0,0 +1,166 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <array>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "trace.h"
+
+namespace {
+struct TraceEvent {
+  const char *name;
+  int64_t arg;
+  /// Nanoseconds since start of recording
+  int64_t begin;
+  int64_t end;
+};
+
+/**
+ * Fixed block of events. Only owner thread appends, size is published after event is written, so writer may read
+ * blocks of running threads.
+ */
+struct TraceChunk {
+  std::array<TraceEvent, 4096> events;
+  std::atomic<size_t> size = 0;
+  std::atomic<TraceChunk *> next = nullptr;
+};
+
+struct ThreadBuffer {
+  uint32_t tid;
+  /// Guarded by registry mutex
+  std::string name;
+  TraceChunk head;
+  /// Last chunk, used only by owner thread
+  TraceChunk *tail = &head;
+
+  ~ThreadBuffer() { clear(); }
+
+  void clear() {
+    for (auto chunk = head.next.exchange(nullptr); chunk != nullptr;) {
+      auto next = chunk->next.load();
+      delete chunk;
+      chunk = next;
+    }
+    head.size.store(0, std::memory_order_relaxed);
+    tail = &head;
+  }
+};
+
+/// Buffers outlive their threads, so spans of finished threads are written too
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+std::atomic<bool> is_recording = false;
+Tracer::Clock::time_point origin;
+thread_local ThreadBuffer *thread_buffer = nullptr;
+
+/// Buffer of calling thread, registered on first use
+ThreadBuffer &current_buffer() {
+  if (thread_buffer == nullptr) {
+    auto &reg = registry();
+    std::lock_guard lock(reg.mutex);
+    auto &buffer = reg.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+    buffer->tid = reg.buffers.size();
+    thread_buffer = buffer.get();
+  }
+  return *thread_buffer;
+}
+
+/// Thread names come from user, so they are escaped to keep JSON valid
+std::string json_escape(std::string_view text) {
+  std::string result;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if ((unsigned char)c < 0x20) {
+      result += std::format("\\u{:04x}", (unsigned char)c);
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+} // namespace
+
+void Tracer::enable() {
+  origin = Clock::now();
+  is_recording.store(true, std::memory_order_release);
+}
+
+void Tracer::disable() {
+  is_recording.store(false, std::memory_order_release);
+  auto &reg = registry();
+  std::lock_guard lock(reg.mutex);
+  for (auto &buffer : reg.buffers) {
+    buffer->clear();
+    buffer->name.clear();
+  }
+}
+
+bool Tracer::is_enabled() { return is_recording.load(std::memory_order_acquire); }
+
+void Tracer::set_thread_name(const std::string &name) {
+  auto &buffer = current_buffer();
+  std::lock_guard lock(registry().mutex);
+  buffer.name = name;
+}
+
+void Tracer::record(const char *name, int64_t arg, Clock::time_point begin, Clock::time_point end) {
+  auto &buffer = current_buffer();
+  TraceChunk *chunk = buffer.tail;
+  size_t size = chunk->size.load(std::memory_order_relaxed);
+  if (size == chunk->events.size()) {
+    auto next = new TraceChunk;
+    chunk->next.store(next, std::memory_order_release);
+    buffer.tail = chunk = next;
+    size = 0;
+  }
+  chunk->events[size] = {name, arg, std::chrono::duration_cast<std::chrono::nanoseconds>(begin - origin).count(),
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(end - origin).count()};
+  chunk->size.store(size + 1, std::memory_order_release);
+}
+
+void Tracer::write(const std::filesystem::path &file) {
+  std::ofstream output(file);
+  if (!output.is_open()) {
+    throw std::runtime_error(std::format("Can't open output file for writing {}", file.string()));
+  }
+
+  auto &reg = registry();
+  std::lock_guard lock(reg.mutex);
+  output << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+  output << R"({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "manhuntribber"}})";
+  for (const auto &buffer : reg.buffers) {
+    if (!buffer->name.empty()) {
+      output << std::format(",\n{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, "
+                            "\"args\": {{\"name\": \"{}\"}}}}",
+                            buffer->tid, json_escape(buffer->name));
+    }
+    for (auto chunk = &buffer->head; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+      size_t size = chunk->size.load(std::memory_order_acquire);
+      for (size_t i = 0; i < size; i++) {
+        const auto &event = chunk->events[i];
+        // Complete events, microseconds
+        output << std::format(",\n{{\"name\": \"{}\", \"cat\": \"codec\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, "
+                              "\"ts\": {:.3f}, \"dur\": {:.3f}",
+                              json_escape(event.name), buffer->tid, event.begin / 1e3, (event.end - event.begin) / 1e3);
+        output << (event.arg < 0 ? "}" : std::format(", \"args\": {{\"index\": {}}}}}", event.arg));
+      }
+    }
+  }
+  output << "\n]}\n";
+}
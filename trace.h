@@ -0,0 +1,62 @@
+/* SPDX-FileCopyrightText: Copyright 2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * Recorder of spans in Chrome trace event format (chrome://tracing, ui.perfetto.dev). Every thread appends spans to
+ * its own buffer without locking, buffers of all threads are written at once when work is done. While recording is
+ * disabled span costs one atomic load.
+ */
+class Tracer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Start recording, timestamps are relative to this moment
+  static void enable();
+  /**
+   * Stop recording and drop recorded spans and thread names. Other threads must not be inside of spans, their buffers
+   * are reset in place.
+   */
+  static void disable();
+  [[nodiscard]] static bool is_enabled();
+  /// Name of calling thread shown in trace
+  static void set_thread_name(const std::string &name);
+  /**
+   * Record span of calling thread. Name isn't copied, so it must be a string literal. Negative arg (e.g. index of
+   * interleave) is omitted.
+   */
+  static void record(const char *name, int64_t arg, Clock::time_point begin, Clock::time_point end);
+  /// Write spans recorded so far by all threads as JSON
+  static void write(const std::filesystem::path &file);
+};
+
+/**
+ * Scoped span of calling thread, does nothing when recording is disabled
+ */
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name, int64_t arg = -1) : m_name(Tracer::is_enabled() ? name : nullptr), m_arg(arg) {
+    if (m_name) {
+      m_begin = Tracer::Clock::now();
+    }
+  }
+  ~TraceSpan() {
+    if (m_name) {
+      Tracer::record(m_name, m_arg, m_begin, Tracer::Clock::now());
+    }
+  }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *m_name;
+  int64_t m_arg;
+  Tracer::Clock::time_point m_begin;
+};
@@ -0,0 +1,293 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "wav.h"
+
+namespace {
+/// Trailing part of Wave64 GUIDs, first 4 bytes are FOURCC of chunk ("riff" has its own GUID)
+constexpr char w64_guid_tail[12] = {'\xF3', '\xAC', '\xD3', '\x11', '\x8C', '\xD1',
+                                    '\x00', '\xC0', '\x4F', '\x8E', '\xDB', '\x8A'};
+constexpr char w64_riff_guid[16] = {'r',    'i',    'f',    'f',    '\x2E', '\x91', '\xCF', '\x11',
+                                    '\xA5', '\xD6', '\x28', '\xDB', '\x04', '\xC1', '\x00', '\x00'};
+
+/**
+ * Sequential reader over memory buffer
+ */
+class SpanReader {
+public:
+  explicit SpanReader(std::span<const char> data) : m_data(data) {}
+
+  bool read(char *buffer, size_t size) {
+    if (size > m_data.size() - m_pos) {
+      return false;
+    }
+    std::memcpy(buffer, m_data.data() + m_pos, size);
+    m_pos += size;
+    return true;
+  }
+
+  bool skip(uint64_t size) {
+    if (size > m_data.size() - m_pos) {
+      return false;
+    }
+    m_pos += size;
+    return true;
+  }
+
+  [[nodiscard]] uint64_t position() const { return m_pos; }
+  [[nodiscard]] uint64_t remaining() const { return m_data.size() - m_pos; }
+
+private:
+  std::span<const char> m_data;
+  uint64_t m_pos = 0;
+};
+
+/**
+ * Sequential reader over (possibly non-seekable) stream
+ */
+class StreamReader {
+public:
+  explicit StreamReader(std::istream &input) : m_input(input) {}
+
+  bool read(char *buffer, size_t size) {
+    if (!m_input.read(buffer, size)) {
+      return false;
+    }
+    m_pos += size;
+    return true;
+  }
+
+  bool skip(uint64_t size) {
+    while (size > 0) {
+      auto step = (std::streamsize)std::min<uint64_t>(size, std::numeric_limits<std::streamsize>::max());
+      m_input.ignore(step);
+      if (m_input.gcount() != step) {
+        return false;
+      }
+      size -= step;
+      m_pos += step;
+    }
+    return true;
+  }
+
+  [[nodiscard]] uint64_t position() const { return m_pos; }
+
+  /// Bytes left in stream, UINT64_MAX if stream isn't seekable (pipe)
+  [[nodiscard]] uint64_t remaining() {
+    auto pos = m_input.tellg();
+    if (pos < 0) {
+      m_input.clear();
+      return UINT64_MAX;
+    }
+    m_input.seekg(0, std::ios::end);
+    auto end = m_input.tellg();
+    m_input.seekg(pos);
+    if (end < 0 || !m_input) {
+      m_input.clear();
+      return UINT64_MAX;
+    }
+    return end - pos;
+  }
+
+private:
+  std::istream &m_input;
+  uint64_t m_pos = 0;
+};
+} // namespace
+
+template <typename T> static T read_le(std::span<const char> data, size_t offset) {
+  T value;
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  return UTILS::convert_le(value);
+}
+
+template <typename T> static void write_le(std::span<char> data, size_t offset, T value) {
+  value = UTILS::convert_le(value);
+  std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+static bool parse_fmt(std::span<const char> body, WavInfo &info) {
+  if (body.size() < 16) {
+    return false;
+  }
+  info.audio_format = read_le<uint16_t>(body, 0);
+  info.nb_channels = read_le<uint16_t>(body, 2);
+  info.frequency = read_le<uint32_t>(body, 4);
+  info.bits_per_sample = read_le<uint16_t>(body, 14);
+  // WAVE_FORMAT_EXTENSIBLE keeps actual format in first bytes of sub-format GUID
+  if (info.audio_format == 0xFFFE && body.size() >= 40) {
+    info.audio_format = read_le<uint16_t>(body, 24);
+  }
+  return true;
+}
+
+/// Fields of "fmt " and "ds64" chunks are in their first bytes, the rest of chunk body is skipped
+constexpr size_t max_chunk_body = 64;
+
+/**
+ * Read body of chunk with padded_size bytes, only first max_chunk_body bytes are kept in buffer. Size comes from file,
+ * so it's checked against remaining input before anything is read.
+ */
+template <typename Reader>
+static std::optional<std::span<const char>> read_chunk_body(Reader &reader, uint64_t padded_size,
+                                                            std::array<char, max_chunk_body> &buffer) {
+  if (padded_size > reader.remaining()) {
+    return std::nullopt;
+  }
+  size_t size = std::min<uint64_t>(padded_size, buffer.size());
+  if (!reader.read(buffer.data(), size) || !reader.skip(padded_size - size)) {
+    return std::nullopt;
+  }
+  return std::span<const char>(buffer.data(), size);
+}
+
+/**
+ * Walk RIFF (or RF64) chunks after 12-byte file header. In RF64 sizes of RIFF and "data" are 0xFFFFFFFF and actual
+ * values are stored in "ds64" chunk, which comes first.
+ */
+template <typename Reader> static std::optional<WavInfo> parse_riff_chunks(Reader &reader, bool is_rf64) {
+  WavInfo info;
+  bool has_fmt = false;
+  uint64_t ds64_data_size = UINT64_MAX;
+  std::array<char, max_chunk_body> buffer;
+  char chunk_header[8];
+  while (reader.read(chunk_header, sizeof(chunk_header))) {
+    uint64_t chunk_size = read_le<uint32_t>(chunk_header, 4);
+    uint64_t padded_size = chunk_size + (chunk_size & 1);
+    if (std::memcmp(chunk_header, "fmt ", 4) == 0 || (is_rf64 && std::memcmp(chunk_header, "ds64", 4) == 0)) {
+      auto body = read_chunk_body(reader, padded_size, buffer);
+      if (!body.has_value()) {
+        return std::nullopt;
+      }
+      if (chunk_header[0] == 'f') {
+        has_fmt = parse_fmt(*body, info);
+      } else if (body->size() >= 16) {
+        ds64_data_size = read_le<uint64_t>(*body, 8);
+      }
+    } else if (std::memcmp(chunk_header, "data", 4) == 0) {
+      if (!has_fmt) {
+        return std::nullopt;
+      }
+      info.data_offset = reader.position();
+      info.data_size = chunk_size != 0xFFFFFFFF ? chunk_size : is_rf64 ? ds64_data_size : UINT64_MAX;
+      return info;
+    } else if (!reader.skip(padded_size)) {
+      return std::nullopt;
+    }
+  }
+  return std::nullopt;
+}
+
+/**
+ * Walk Wave64 chunks after 40-byte file header. Chunks are identified by GUIDs, sizes are 64-bit and include 24-byte
+ * chunk header, chunks are aligned to 8 bytes.
+ */
+template <typename Reader> static std::optional<WavInfo> parse_w64_chunks(Reader &reader) {
+  WavInfo info;
+  bool has_fmt = false;
+  std::array<char, max_chunk_body> buffer;
+  char chunk_header[24];
+  while (reader.read(chunk_header, sizeof(chunk_header))) {
+    uint64_t chunk_size = read_le<uint64_t>(chunk_header, 16);
+    if (chunk_size < sizeof(chunk_header)) {
+      return std::nullopt;
+    }
+    chunk_size -= sizeof(chunk_header);
+    uint64_t padded_size = (chunk_size + 7) & ~uint64_t(7);
+    bool is_known = std::memcmp(chunk_header + 4, w64_guid_tail, sizeof(w64_guid_tail)) == 0;
+    if (is_known && std::memcmp(chunk_header, "fmt ", 4) == 0) {
+      auto body = read_chunk_body(reader, padded_size, buffer);
+      if (!body.has_value()) {
+        return std::nullopt;
+      }
+      has_fmt = parse_fmt(*body, info);
+    } else if (is_known && std::memcmp(chunk_header, "data", 4) == 0) {
+      if (!has_fmt) {
+        return std::nullopt;
+      }
+      info.data_offset = reader.position();
+      info.data_size = chunk_size;
+      return info;
+    } else if (!reader.skip(padded_size)) {
+      return std::nullopt;
+    }
+  }
+  return std::nullopt;
+}
+
+template <typename Reader> static std::optional<WavInfo> parse_wav_file(Reader &reader) {
+  char header[40];
+  if (!reader.read(header, 12)) {
+    return std::nullopt;
+  }
+  if (std::memcmp(header + 8, "WAVE", 4) == 0) {
+    if (std::memcmp(header, "RIFF", 4) == 0) {
+      return parse_riff_chunks(reader, false);
+    }
+    if (std::memcmp(header, "RF64", 4) == 0 || std::memcmp(header, "BW64", 4) == 0) {
+      return parse_riff_chunks(reader, true);
+    }
+  }
+  if (std::memcmp(header, w64_riff_guid, 12) == 0 && reader.read(header + 12, 28) &&
+      std::memcmp(header, w64_riff_guid, sizeof(w64_riff_guid)) == 0 && std::memcmp(header + 24, "wave", 4) == 0 &&
+      std::memcmp(header + 28, w64_guid_tail, sizeof(w64_guid_tail)) == 0) {
+    return parse_w64_chunks(reader);
+  }
+  return std::nullopt;
+}
+
+std::vector<char> make_wav_header(uint32_t nb_channels, uint32_t frequency, std::optional<uint64_t> data_size) {
+  wav_hdr wave_header;
+  wave_header.NumOfChan = UTILS::convert_le((uint16_t)nb_channels);
+  wave_header.SamplesPerSec = UTILS::convert_le(frequency);
+  wave_header.blockAlign = UTILS::convert_le((uint16_t)(nb_channels * 2));
+  wave_header.bytesPerSec = UTILS::convert_le(frequency * nb_channels * 2);
+  wave_header.ChunkSize = 0xFFFFFFFF;
+  wave_header.Subchunk2Size = 0xFFFFFFFF;
+
+  auto bytes = reinterpret_cast<const char *>(&wave_header);
+  if (!data_size.has_value()) {
+    return {bytes, bytes + sizeof(wav_hdr)};
+  }
+  if (*data_size + sizeof(wav_hdr) - 8 <= 0xFFFFFFFF) {
+    wave_header.ChunkSize = UTILS::convert_le((uint32_t)(*data_size + sizeof(wav_hdr) - 8));
+    wave_header.Subchunk2Size = UTILS::convert_le((uint32_t)*data_size);
+    return {bytes, bytes + sizeof(wav_hdr)};
+  }
+
+  // RF64 (EBU Tech 3306): 32-bit sizes are 0xFFFFFFFF, real ones are in "ds64" chunk right after file header
+  size_t header_size = sizeof(wav_hdr) + 36;
+  std::vector<char> header(header_size);
+  std::memcpy(header.data(), "RF64", 4);
+  write_le<uint32_t>(header, 4, 0xFFFFFFFF);
+  std::memcpy(header.data() + 8, "WAVEds64", 8);
+  write_le<uint32_t>(header, 16, 28);
+  write_le<uint64_t>(header, 20, *data_size + header_size - 8);
+  write_le<uint64_t>(header, 28, *data_size);
+  write_le<uint64_t>(header, 36, *data_size / (nb_channels * 2));
+  write_le<uint32_t>(header, 44, 0);
+  // "fmt " and "data" chunks are the same as in plain WAV
+  std::memcpy(header.data() + 48, bytes + 12, sizeof(wav_hdr) - 12);
+  return header;
+}
+
+std::optional<WavInfo> parse_wav(std::span<const char> data) {
+  SpanReader reader(data);
+  auto info = parse_wav_file(reader);
+  if (info) {
+    // Streaming-style or truncated files have less data than declared
+    info->data_size = std::min<uint64_t>(info->data_size, data.size() - info->data_offset);
+  }
+  return info;
+}
+
+std::optional<WavInfo> parse_wav(std::istream &input) {
+  StreamReader reader(input);
+  return parse_wav_file(reader);
+}
@@ -0,0 +1,62 @@
+/* SPDX-FileCopyrightText: Copyright 2024-2025 Azamat H. Hackimov <azamat.hackimov@gmail.com> */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "byteswap.h"
+
+typedef struct WAV_HEADER {
+  char RIFF[4] = {'R', 'I', 'F', 'F'};               // RIFF Header      Magic header
+  uint32_t ChunkSize = 0;                            // RIFF Chunk Size
+  char WAVE[4] = {'W', 'A', 'V', 'E'};               // WAVE Header
+  char fmt[4] = {'f', 'm', 't', ' '};                // FMT header
+  uint32_t Subchunk1Size = UTILS::convert_le(16);    // Size of the fmt chunk
+  uint16_t AudioFormat = UTILS::convert_le(1);       // Audio format 1=PCM
+  uint16_t NumOfChan = UTILS::convert_le(2);         // Number of channels 1=Mono 2=Stereo
+  uint32_t SamplesPerSec = UTILS::convert_le(44100); // Sampling Frequency in Hz
+  uint32_t bytesPerSec = UTILS::convert_le(176400);  // bytes per second (SamplesPerSec * blockAlign)
+  uint16_t blockAlign = UTILS::convert_le(4);        // 2=16-bit mono, 4=16-bit stereo
+  uint16_t bitsPerSample = UTILS::convert_le(16);    // Number of bits per sample
+  char Subchunk2ID[4] = {'d', 'a', 't', 'a'};        // "data"  string
+  uint32_t Subchunk2Size = 0;                        // Sampled data length
+} wav_hdr;
+
+/**
+ * Construct header of PCM 16-bit WAV file. Unknown data size gives streaming-style header (sizes are 0xFFFFFFFF), data
+ * larger than 4 GiB gives RF64 header with "ds64" chunk (80 bytes instead of 44).
+ */
+std::vector<char> make_wav_header(uint32_t nb_channels, uint32_t frequency, std::optional<uint64_t> data_size);
+
+/**
+ * Format and location of PCM data in WAV file
+ */
+struct WavInfo {
+  uint16_t audio_format = 0;
+  uint16_t nb_channels = 0;
+  uint32_t frequency = 0;
+  uint16_t bits_per_sample = 0;
+  /// Offset of "data" chunk contents from the start of file
+  uint64_t data_offset = 0;
+  /// Size of "data" chunk contents, UINT64_MAX if unknown (streaming-style header)
+  uint64_t data_size = 0;
+
+  /// Is it 16-bit PCM (plain or extensible format)
+  [[nodiscard]] bool is_pcm16() const { return audio_format == 1 && bits_per_sample == 16; }
+};
+
+/**
+ * Parse WAV file in memory walking through RIFF chunks (LIST, fact and others are skipped) up to "data" chunk.
+ * RF64/BW64 and Wave64 files are accepted as well.
+ * Size of data is limited by buffer size.
+ */
+std::optional<WavInfo> parse_wav(std::span<const char> data);
+
+/**
+ * Parse WAV (RF64, Wave64) stream walking through chunks, stream is left at the start of "data" chunk contents.
+ */
+std::optional<WavInfo> parse_wav(std::istream &input);